@@ -0,0 +1,101 @@
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "channel.hh"
+
+// the channel as it used to be: a std::queue behind a mutex and a condition variable.
+template <typename T>
+class locked_queue {
+  std::queue<T> queue;
+  std::mutex m;
+  std::condition_variable cv;
+
+public:
+  void send(T val)
+  {
+    std::lock_guard<std::mutex> lock{m};
+    queue.push(std::move(val));
+    cv.notify_one();
+  }
+  T recv()
+  {
+    std::unique_lock<std::mutex> lock{m};
+    cv.wait(lock, [this] { return !queue.empty(); });
+    T val = std::move(queue.front());
+    queue.pop();
+    return val;
+  }
+};
+
+constexpr std::size_t count = 4000000;
+
+template <typename Send, typename Recv>
+void run(char const* name, int num_senders, Send send, Recv recv)
+{
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> senders;
+  for (int s = 0; s < num_senders; ++s) {
+    senders.emplace_back([&, s] {
+      for (std::size_t i = s; i < count; i += num_senders) {
+        send(i);
+      }
+    });
+  }
+  std::size_t sum = recv();
+  for (auto& th : senders) {
+    th.join();
+  }
+  double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << name << " x" << num_senders << ": " << static_cast<int>(count / sec / 1e6) << " M msgs/s (sum "
+            << sum << ")" << std::endl;
+}
+
+int main()
+{
+  for (int num_senders : {1, 4}) {
+    locked_queue<std::size_t> queue;
+    run("locked queue      ", num_senders, [&](std::size_t i) { queue.send(i); },
+        [&] {
+          std::size_t sum = 0;
+          for (std::size_t n = 0; n < count; ++n) {
+            sum += queue.recv();
+          }
+          return sum;
+        });
+
+    sender<std::size_t> tx;
+    receiver<std::size_t> rx;
+    std::tie(tx, rx) = make_channel<std::size_t>();
+    run("channel, recv     ", num_senders, [&](std::size_t i) { tx.send(i); },
+        [&] {
+          std::size_t sum = 0;
+          for (std::size_t n = 0; n < count; ++n) {
+            sum += rx.recv();
+          }
+          return sum;
+        });
+
+    std::tie(tx, rx) = make_channel<std::size_t>();
+    run("channel, recv_all ", num_senders, [&](std::size_t i) { tx.send(i); },
+        [&] {
+          std::size_t sum = 0;
+          std::vector<std::size_t> batch;
+          for (std::size_t n = 0; n < count;) {
+            batch.clear();
+            if (rx.recv_all(batch) == 0) {
+              batch.push_back(rx.recv());
+            }
+            for (auto i : batch) {
+              sum += i;
+            }
+            n += batch.size();
+          }
+          return sum;
+        });
+  }
+}
@@ -0,0 +1,59 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "line_store.hh"
+
+// a writer appends lines in batches while readers keep taking snapshots and checking every line they see.
+int main()
+{
+  constexpr std::size_t num_lines = 5000000;
+  constexpr int num_readers = 3;
+
+  LineStore lines;
+  std::atomic<bool> finished{false};
+  std::atomic<std::size_t> errors{0};
+
+  std::vector<std::thread> readers;
+  for (int r = 0; r < num_readers; ++r) {
+    readers.emplace_back([&, r] {
+      std::size_t snapshots = 0, checked = 0;
+      while (!finished.load()) {
+        auto snapshot = lines.snapshot();
+        ++snapshots;
+        // the newest lines, and a stride over the older ones.
+        std::size_t n = snapshot.size();
+        for (std::size_t i = n > 4096 ? n - 4096 : 0; i < n; ++i, ++checked) {
+          errors += snapshot[i] != std::to_string(i);
+        }
+        for (std::size_t i = r; i < n; i += 9973, ++checked) {
+          errors += snapshot[i] != std::to_string(i);
+        }
+      }
+      std::cout << "reader " << r << ": " << snapshots << " snapshots, " << checked << " lines checked" << std::endl;
+    });
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  LineStore batch;
+  for (std::size_t i = 0; i < num_lines; ++i) {
+    batch.push_back(std::to_string(i));
+    if (batch.size() == 4096 || i + 1 == num_lines) {
+      lines.append(batch);
+      batch.clear();
+    }
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  finished = true;
+  for (auto& th : readers) {
+    th.join();
+  }
+
+  std::cout << "appended " << lines.size() << " lines in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() << " ms, " << errors.load()
+            << " errors" << std::endl;
+  return errors.load() == 0 && lines.size() == num_lines ? 0 : 1;
+}
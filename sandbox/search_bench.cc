@@ -0,0 +1,38 @@
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "search.hh"
+
+// compares find_substring() against std::string_view::find on cache-resident log-like lines.
+int main()
+{
+  std::mt19937 rng(42);
+  std::vector<std::string> lines;
+  for (int i = 0; i < 4000; ++i) {
+    std::string line = "2016-10-17T12:34:56.789Z INFO [worker-" + std::to_string(i % 64) + "] ";
+    while (line.size() < 240) {
+      line += "/usr/local/share/app/module" + std::to_string(rng() % 1000) + " ";
+    }
+    lines.push_back(std::move(line));
+  }
+
+  auto measure = [&](char const* name, auto&& find) {
+    for (std::string needle : {"ERROR", "module9999", "worker-63]"}) {
+      auto start = std::chrono::steady_clock::now();
+      std::size_t hits = 0;
+      for (int round = 0; round < 100; ++round) {
+        for (auto& line : lines) {
+          hits += find(line, needle) != std::string_view::npos;
+        }
+      }
+      std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+      std::cout << name << " " << needle << ": " << elapsed.count() << " ms (" << hits << " hits)" << std::endl;
+    }
+  };
+
+  measure("std::string_view::find", [](std::string_view line, std::string_view needle) { return line.find(needle); });
+  measure("find_substring", [](std::string_view line, std::string_view needle) { return find_substring(line, needle); });
+}
@@ -0,0 +1,86 @@
+#include "ansi.hh"
+
+#include <cstring>
+
+namespace {
+
+constexpr char ESC = '\x1B';
+constexpr char BEL = '\x07';
+
+bool in_range(char ch, unsigned lo, unsigned hi)
+{
+  auto c = static_cast<unsigned char>(ch);
+  return lo <= c && c <= hi;
+}
+
+// returns the position just after the sequence which starts with ESC at `pos`.
+// an unterminated sequence extends to the end of line.
+std::size_t skip_sequence(std::string_view line, std::size_t pos)
+{
+  std::size_t const n = line.size();
+  std::size_t i = pos + 1;
+  if (i == n) {
+    return n;
+  }
+
+  char kind = line[i++];
+  if (kind == '[') {
+    // CSI: parameter bytes, intermediate bytes and a final byte.
+    while (i < n && in_range(line[i], 0x30, 0x3F))
+      ++i;
+    while (i < n && in_range(line[i], 0x20, 0x2F))
+      ++i;
+    return (i < n && in_range(line[i], 0x40, 0x7E)) ? i + 1 : i;
+  }
+  if (kind == ']' || kind == 'P' || kind == 'X' || kind == '^' || kind == '_') {
+    // OSC, DCS, SOS, PM and APC: a string terminated by ST (ESC \), or BEL for OSC.
+    for (; i < n; ++i) {
+      if (line[i] == BEL && kind == ']') {
+        return i + 1;
+      }
+      if (line[i] == ESC) {
+        return (i + 1 < n && line[i + 1] == '\\') ? i + 2 : i;
+      }
+    }
+    return n;
+  }
+  if (in_range(kind, 0x20, 0x2F)) {
+    // nF: intermediate bytes followed by a final byte, e.g. ESC ( B.
+    while (i < n && in_range(line[i], 0x20, 0x2F))
+      ++i;
+    return (i < n && in_range(line[i], 0x30, 0x7E)) ? i + 1 : i;
+  }
+  if (in_range(kind, 0x30, 0x7E)) {
+    // two-byte sequences, e.g. ESC 7 and ESC =.
+    return i;
+  }
+
+  // a stray ESC.
+  return pos + 1;
+}
+
+} // namespace
+
+bool strip_ansi(std::string_view line, std::string& out)
+{
+  auto esc = static_cast<char const*>(std::memchr(line.data(), ESC, line.size()));
+  if (esc == nullptr) {
+    return false;
+  }
+
+  out.clear();
+  std::size_t pos = esc - line.data();
+  std::size_t begin = 0;
+  while (true) {
+    out.append(line.data() + begin, pos - begin);
+    begin = skip_sequence(line, pos);
+
+    esc = static_cast<char const*>(std::memchr(line.data() + begin, ESC, line.size() - begin));
+    if (esc == nullptr) {
+      break;
+    }
+    pos = esc - line.data();
+  }
+  out.append(line.data() + begin, line.size() - begin);
+  return true;
+}
@@ -0,0 +1,11 @@
+#ifndef __HEADER_ANSI__
+#define __HEADER_ANSI__
+
+#include <string>
+#include <string_view>
+
+// removes terminal escape sequences (CSI, OSC, DCS and other ESC-prefixed sequences) from `line`.
+// returns false and leaves `out` untouched if `line` contains no ESC byte, so callers can keep the original.
+bool strip_ansi(std::string_view line, std::string& out);
+
+#endif
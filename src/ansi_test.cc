@@ -0,0 +1,39 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include "ansi.hh"
+
+static std::string strip(std::string const& line)
+{
+  std::string out;
+  return strip_ansi(line, out) ? out : line;
+}
+
+TEST(ansi_test, plain)
+{
+  std::string out = "untouched";
+  EXPECT_FALSE(strip_ansi("plain text", out));
+  EXPECT_EQ("untouched", out);
+}
+
+TEST(ansi_test, sgr)
+{
+  EXPECT_EQ("red text", strip("\x1B[31mred\x1B[0m text"));
+  EXPECT_EQ("bold", strip("\x1B[1;38;5;208mbold\x1B[m"));
+  EXPECT_EQ("truecolor", strip("\x1B[38;2;255;128;0mtruecolor\x1B[K"));
+}
+
+TEST(ansi_test, other_sequences)
+{
+  EXPECT_EQ("up", strip("\x1B[?25lup\x1B[2A"));
+  EXPECT_EQ("link", strip("\x1B]8;;http://example.com\x1B\\link\x1B]8;;\x07"));
+  EXPECT_EQ("charset", strip("\x1B(Bcharset"));
+  EXPECT_EQ("keypad", strip("\x1B=keypad"));
+}
+
+TEST(ansi_test, truncated)
+{
+  EXPECT_EQ("abc", strip("abc\x1B[31"));
+  EXPECT_EQ("abc", strip("abc\x1B"));
+  EXPECT_EQ(u8"ほげ", strip(u8"\x1B[1mほげ"));
+}
@@ -70,10 +70,10 @@ public:
   arc() : body{std::make_shared<lockable<T, Mutex>>()} {}
   arc(T body) : body{std::make_shared<lockable<T, Mutex>>(std::move(body))} {}
 
-  locked<T, std::mutex> lock() { return body->lock(); }
-  locked_shared<T, std::shared_timed_mutex> read() { return body->read(); }
+  locked<T, Mutex> lock() { return body->lock(); }
+  locked_shared<T, Mutex> read() { return body->read(); }
 
-  lockable<T>& get() { return *body; }
+  lockable<T, Mutex>& get() { return *body; }
 };
 
 #endif
@@ -0,0 +1,273 @@
+#include "batch.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <ostream>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+#include "ansi.hh"
+#include "choice.hh"
+#include "line_store.hh"
+#include "thread_pool.hh"
+
+constexpr std::size_t read_size = 1 << 20;
+constexpr std::size_t output_buffer_size = 1 << 20;
+constexpr std::size_t indexed_chunk_size = 65536;
+
+namespace {
+
+// collects output into one large buffer, rather than flushing every line.
+class Output {
+  std::ostream& os;
+  std::string buf;
+
+public:
+  explicit Output(std::ostream& os) : os{os} { buf.reserve(output_buffer_size + 4096); }
+  ~Output() { flush(); }
+
+  void write_line(std::string_view line)
+  {
+    buf.append(line);
+    buf += '\n';
+    if (buf.size() >= output_buffer_size) {
+      flush();
+    }
+  }
+
+  void flush()
+  {
+    os.write(buf.data(), buf.size());
+    buf.clear();
+  }
+};
+
+// reads `fd` until `buf` is full or the input ends, starting at `len`. returns false at the end of input.
+bool fill(int fd, std::vector<char>& buf, std::size_t& len)
+{
+  while (len < buf.size()) {
+    ssize_t n = ::read(fd, buf.data() + len, buf.size() - len);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(), "read");
+    }
+    if (n == 0) {
+      return false;
+    }
+    len += n;
+  }
+  return true;
+}
+
+// the matches of a ranked filter, whose lines are copied as the chunks they come from are dropped.
+// with a limit, only the best `limit` of them are kept.
+class RankedMatches {
+  LineStore lines;
+  std::vector<Choice> choices;
+  std::size_t limit;
+
+public:
+  explicit RankedMatches(std::size_t limit) : limit{limit} {}
+
+  void add(std::string_view line, float score)
+  {
+    Choice choice{lines.size()};
+    choice.score = score;
+    choices.push_back(choice);
+    lines.push_back(line);
+    if (limit > 0 && choices.size() >= std::max<std::size_t>(2 * limit, 65536)) {
+      compact();
+    }
+  }
+
+  std::size_t write(Output& out)
+  {
+    std::size_t n = limit > 0 ? std::min(limit, choices.size()) : choices.size();
+    if (n < choices.size()) {
+      std::partial_sort(choices.begin(), choices.begin() + n, choices.end(), std::greater<Choice>{});
+    }
+    else {
+      rank_choices(choices.begin(), choices.end());
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+      out.write_line(lines[choices[i].index]);
+    }
+    return n;
+  }
+
+private:
+  // drops all but the best `limit` choices. the survivors are renumbered in input order, which breaks ties.
+  void compact()
+  {
+    std::nth_element(choices.begin(), choices.begin() + limit, choices.end(), std::greater<Choice>{});
+    choices.resize(limit);
+    std::sort(choices.begin(), choices.end(), [](auto& a, auto& b) { return a.index < b.index; });
+
+    LineStore kept;
+    for (auto& choice : choices) {
+      kept.push_back(lines[choice.index]);
+      choice.index = static_cast<std::uint32_t>(kept.size() - 1);
+    }
+    lines = std::move(kept);
+  }
+};
+
+// scores chunks of lines and writes the matched ones.
+class Batch {
+  BatchOptions const& options;
+  std::unique_ptr<Filter> filter;
+  bool ranked;
+  ThreadPool pool;
+  Output out;
+  RankedMatches matches;
+  std::size_t written = 0;
+  std::vector<Choice> choices;
+
+public:
+  Batch(std::ostream& os, FilterMode mode, std::string const& query, BatchOptions const& options)
+      : options{options}, filter{score_by(mode, query)}, ranked{options.sorted && filter->is_ranked()},
+        pool{options.num_threads}, out{os}, matches{options.limit}
+  {
+  }
+
+  Filter const& get_filter() const { return *filter; }
+
+  // returns false if no more lines are needed.
+  bool process(LineStore const& lines)
+  {
+    choices.resize(lines.size());
+    for (std::size_t i = 0; i < choices.size(); ++i) {
+      choices[i] = Choice(i);
+    }
+    std::size_t matched = filter->scoring(choices.begin(), choices.end(), lines, pool, options.score_min);
+    for (std::size_t i = 0; i < matched; ++i) {
+      if (ranked) {
+        matches.add(lines[choices[i].index], choices[i].score);
+      }
+      else {
+        out.write_line(lines[choices[i].index]);
+        if (++written == options.limit) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // writes the ranked matches, and returns the number of lines written.
+  std::size_t finish() { return ranked ? matches.write(out) : written; }
+};
+
+} // namespace
+
+std::size_t filter_batch(int fd, std::ostream& os, FilterMode mode, std::string const& query,
+                         BatchOptions const& options)
+{
+  Batch batch{os, mode, query, options};
+  std::size_t num_lines = 0;
+  LineStore lines;
+  std::string stripped;
+
+  std::vector<char> buf(read_size);
+  std::size_t len = 0;
+  for (bool more = true; more && num_lines < options.max_lines;) {
+    more = fill(fd, buf, len);
+
+    // lines are borrowed from the buffer, which is left as it is until they are scored.
+    char const* p = buf.data();
+    char const* end = p + len;
+    while (num_lines < options.max_lines) {
+      auto eol = static_cast<char const*>(std::memchr(p, '\n', end - p));
+      if (eol == nullptr) {
+        // the last line may lack a newline.
+        if (more || p == end) {
+          break;
+        }
+        eol = end;
+      }
+      std::string_view line(p, eol - p);
+      if (strip_ansi(line, stripped)) {
+        lines.stage(stripped);
+      }
+      else {
+        lines.stage_borrowed(line);
+      }
+      ++num_lines;
+      p = std::min(eol + 1, end);
+    }
+    lines.commit();
+    if (!lines.empty() && !batch.process(lines)) {
+      return batch.finish();
+    }
+    lines.clear();
+
+    // the incomplete line is moved to the front, and the buffer is grown if nothing else fits.
+    len = end - p;
+    std::memmove(buf.data(), p, len);
+    if (len == buf.size()) {
+      buf.resize(buf.size() * 2);
+    }
+  }
+
+  return batch.finish();
+}
+
+std::size_t filter_batch(TrigramIndex const& index, std::ostream& os, FilterMode mode, std::string const& query,
+                         BatchOptions const& options)
+{
+  Batch batch{os, mode, query, options};
+  std::size_t const num_lines = std::min(index.num_lines(), options.max_lines);
+  std::vector<std::uint32_t> found;
+  bool const indexed = index.lookup(batch.get_filter().required_substrings(), 0, num_lines, found);
+  std::size_t const count = indexed ? found.size() : num_lines;
+
+  LineStore lines;
+  std::string stripped;
+  auto escaped = index.escaped_begin();
+  for (std::size_t pos = 0; pos < count;) {
+    for (std::size_t end = std::min(count, pos + indexed_chunk_size); pos < end; ++pos) {
+      std::size_t i = indexed ? found[pos] : pos;
+      escaped = std::lower_bound(escaped, index.escaped_end(), i);
+      if (escaped != index.escaped_end() && *escaped == i) {
+        strip_ansi(index.line(i), stripped);
+        lines.stage(stripped);
+      }
+      else {
+        lines.stage_borrowed(index.line(i));
+      }
+    }
+    lines.commit();
+    if (!batch.process(lines)) {
+      break;
+    }
+    lines.clear();
+  }
+  return batch.finish();
+}
+
+std::size_t filter_batch(std::string const& file, std::ostream& os, FilterMode mode, std::string const& query,
+                         BatchOptions const& options)
+{
+  if (file.empty()) {
+    return filter_batch(STDIN_FILENO, os, mode, query, options);
+  }
+
+  int fd = ::open(file.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), file);
+  }
+  try {
+    auto written = filter_batch(fd, os, mode, query, options);
+    ::close(fd);
+    return written;
+  }
+  catch (...) {
+    ::close(fd);
+    throw;
+  }
+}
@@ -0,0 +1,31 @@
+#ifndef __HEADER_BATCH__
+#define __HEADER_BATCH__
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include "filter.hh"
+#include "trigram_index.hh"
+
+struct BatchOptions {
+  double score_min = 0.01;
+  std::size_t max_lines = static_cast<std::size_t>(-1);
+  std::size_t limit = 0;   // the number of lines written at most, or 0 for all of them.
+  bool sorted = true;      // whether matches of a ranked filter are written by rank rather than in input order.
+  std::size_t num_threads = 0;
+};
+
+// filters the lines read from `fd` with `query` without a terminal, and writes the matched ones to `os`.
+// input is read in large chunks, each of which is scored in parallel and dropped unless some of its lines are
+// kept for ranking. if matches are written in input order, reading stops as soon as `limit` lines are written.
+// returns the number of lines written.
+std::size_t filter_batch(int fd, std::ostream& os, FilterMode mode, std::string const& query,
+                         BatchOptions const& options);
+// reads the lines of an indexed file, of which only the ones found by the index for `query` are scored.
+std::size_t filter_batch(TrigramIndex const& index, std::ostream& os, FilterMode mode, std::string const& query,
+                         BatchOptions const& options);
+// reads `file`, or stdin if it is empty.
+std::size_t filter_batch(std::string const& file, std::ostream& os, FilterMode mode, std::string const& query,
+                         BatchOptions const& options);
+
+#endif
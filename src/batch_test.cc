@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include "batch.hh"
+
+// makes an empty file of a unique name in the temporary directory.
+static std::string make_temp_file(std::string const& name)
+{
+  auto path = (std::filesystem::temp_directory_path() / (name + ".XXXXXX")).string();
+  int fd = ::mkstemp(&path[0]);
+  if (fd >= 0) {
+    ::close(fd);
+  }
+  return path;
+}
+
+// runs filter_batch() on `input` through a temporary file.
+static std::string run(std::string const& input, FilterMode mode, std::string const& query,
+                       BatchOptions const& options = {}, std::size_t* written = nullptr)
+{
+  std::FILE* file = std::tmpfile();
+  std::fwrite(input.data(), 1, input.size(), file);
+  std::rewind(file);
+  std::ostringstream os;
+  auto n = filter_batch(fileno(file), os, mode, query, options);
+  std::fclose(file);
+  if (written) {
+    *written = n;
+  }
+  return os.str();
+}
+
+TEST(batch_test, input_order)
+{
+  std::size_t written;
+  // escape sequences are stripped, and the last line may lack a newline.
+  EXPECT_EQ("foo\nfoobar\nbazfoo\n",
+            run("foo\nbar\nfoobar\n\x1b[1mbaz\x1b[0mfoo", FilterMode::SmartCase, "foo", {}, &written));
+  EXPECT_EQ(3, written);
+
+  EXPECT_EQ("", run("foo\nbar\n", FilterMode::SmartCase, "baz", {}, &written));
+  EXPECT_EQ(0, written);
+}
+
+TEST(batch_test, limit)
+{
+  std::string input;
+  for (int i = 0; i < 100000; ++i) {
+    input += "line" + std::to_string(i) + "\n";
+  }
+  BatchOptions options;
+  options.limit = 3;
+  EXPECT_EQ("line7\nline17\nline27\n", run(input, FilterMode::CaseSensitive, "7", options));
+
+  options.limit = 0;
+  options.max_lines = 20;
+  EXPECT_EQ("line7\nline17\n", run(input, FilterMode::CaseSensitive, "7", options));
+}
+
+TEST(batch_test, ranked)
+{
+  std::vector<std::string> lines;
+  std::string input;
+  for (int i = 0; i < 200000; ++i) {
+    lines.push_back((i % 3 ? "src/" : "lib/") + std::to_string(i % 997) + "/main.cc");
+    input += lines.back() + "\n";
+  }
+
+  // the same order as the filter scores them, with ties in input order.
+  auto filter = score_by(FilterMode::Fuzzy, "s9m");
+  std::vector<std::pair<double, std::size_t>> scored;
+  for (std::size_t i = 0; i < lines.size(); ++i) {
+    float score = static_cast<float>((*filter)(lines[i]));
+    if (score > 0.01f) {
+      scored.emplace_back(-score, i);
+    }
+  }
+  std::stable_sort(scored.begin(), scored.end(), [](auto& a, auto& b) { return a.first < b.first; });
+  std::string expected, top;
+  for (std::size_t i = 0; i < scored.size(); ++i) {
+    expected += lines[scored[i].second] + "\n";
+    if (i < 10) {
+      top += lines[scored[i].second] + "\n";
+    }
+  }
+  ASSERT_FALSE(scored.empty());
+
+  EXPECT_EQ(expected, run(input, FilterMode::Fuzzy, "s9m"));
+
+  BatchOptions options;
+  options.limit = 10;
+  EXPECT_EQ(top, run(input, FilterMode::Fuzzy, "s9m", options));
+
+  options.limit = 0;
+  options.sorted = false;
+  auto unsorted = run(input, FilterMode::Fuzzy, "s9m", options);
+  EXPECT_EQ(expected.size(), unsorted.size());
+  auto first = std::min_element(scored.begin(), scored.end(), [](auto& a, auto& b) { return a.second < b.second; });
+  auto first_line = lines[first->second] + "\n";
+  EXPECT_EQ(first_line, unsorted.substr(0, unsorted.find('\n') + 1));
+}
+
+TEST(batch_test, long_line)
+{
+  std::string large(3 << 20, 'x');
+  EXPECT_EQ(large + "y\n", run("a\n" + large + "y\nb\n", FilterMode::SmartCase, "xy"));
+}
+
+// an index gives the same lines as reading the whole file.
+TEST(batch_test, indexed)
+{
+  std::string input;
+  for (int i = 0; i < 20000; ++i) {
+    input += (i % 5 ? "src/Module" : "\x1b[31mlib/module\x1b[0m") + std::to_string(i % 313) + "/Main_" + std::to_string(i) +
+             (i % 7 ? ".cc\n" : u8".cc 日本語\n");
+  }
+  auto path = make_temp_file("batch_indexed");
+  {
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    std::fwrite(input.data(), 1, input.size(), file);
+    std::fclose(file);
+  }
+  auto index = TrigramIndex::load(path);
+  ASSERT_NE(nullptr, index);
+
+  std::pair<FilterMode, std::string> queries[] = {
+      {FilterMode::CaseSensitive, "Module31"}, {FilterMode::SmartCase, "module31 main_1"},
+      {FilterMode::SmartCase, "Module31"},     {FilterMode::SmartCase, u8"日本語 lib"},
+      {FilterMode::SmartCase, "ma"},           {FilterMode::Regex, "odule3[0-2]/main_1"},
+      {FilterMode::Regex, "(31|32)/"},         {FilterMode::Fuzzy, "m31mc"},
+  };
+  BatchOptions options;
+  options.limit = 500;
+  for (auto& query : queries) {
+    std::ostringstream expected, actual;
+    filter_batch(path, expected, query.first, query.second, options);
+    filter_batch(*index, actual, query.first, query.second, options);
+    EXPECT_EQ(expected.str(), actual.str()) << query.second;
+  }
+}
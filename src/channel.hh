@@ -1,41 +1,201 @@
 #ifndef __HEADER_CHANNEL__
 #define __HEADER_CHANNEL__
 
+#include <atomic>
 #include <condition_variable>
+#include <cstdint>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <new>
+#include <stdexcept>
 #include <tuple>
+#include <vector>
+#include "notifier.hh"
 
+constexpr std::size_t default_channel_capacity = 1024;
+
+// a bounded queue of values from any number of senders to one receiver.
+//
+// values are moved through a ring of cells, each of which has a sequence number telling whose turn it is
+// (see http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue).
+// neither side takes a lock while the ring is neither empty nor full.
+// a receiver waits for values, and senders for room, on condition variables, which are notified only if
+// someone is sleeping on them.
 template <typename T>
 class channel {
-  std::queue<T> queue;
+  struct Cell {
+    std::atomic<std::size_t> sequence;
+    alignas(T) unsigned char storage[sizeof(T)];
+
+    T* value() noexcept { return std::launder(reinterpret_cast<T*>(storage)); }
+  };
+
+  std::unique_ptr<Cell[]> cells;
+  std::size_t const mask;
+  alignas(64) std::atomic<std::size_t> tail{0};
+  alignas(64) std::size_t head = 0; // only the receiver touches it.
+
+  alignas(64) std::atomic<bool> receiving{false};
+  std::atomic<bool> sending{false};
+  std::atomic<bool> closed{false};
   std::mutex m;
-  std::condition_variable cv;
+  std::condition_variable not_empty, not_full;
+
+  std::shared_ptr<Notifier> notifier;
 
 public:
-  void send(T const& val)
+  // `notifier` is notified on every send, for receivers waiting in poll().
+  // `capacity` is rounded up to a power of two.
+  explicit channel(std::shared_ptr<Notifier> notifier = nullptr, std::size_t capacity = default_channel_capacity)
+      : mask{round_up(capacity) - 1}, notifier{std::move(notifier)}
   {
-    std::unique_lock<std::mutex> lock{m};
-    queue.push(val);
-    cv.notify_one();
+    cells.reset(new Cell[mask + 1]);
+    for (std::size_t i = 0; i <= mask; ++i) {
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
   }
+  channel(channel const&) = delete;
+  channel& operator=(channel const&) = delete;
 
+  ~channel()
+  {
+    for (T val; pop(val);) {
+    }
+  }
+
+  // blocks while the channel is full. the value is dropped if the receiver has gone.
   void send(T&& val)
   {
-    std::unique_lock<std::mutex> lock{m};
-    queue.push(val);
-    cv.notify_one();
+    while (!push(val)) {
+      if (closed.load()) {
+        return;
+      }
+      wait(sending, not_full, [this] { return closed.load() || has_room(); });
+    }
+    wake(receiving, not_empty);
+    if (notifier)
+      notifier->notify();
   }
 
+  void send(T const& val) { send(T{val}); }
+
+  std::shared_ptr<Notifier> const& get_notifier() const noexcept { return notifier; }
+
   T recv()
   {
-    std::unique_lock<std::mutex> lock{m};
-    cv.wait(lock, [this] { return !queue.empty(); });
-    T result = queue.front();
-    queue.pop();
+    T result;
+    while (!try_recv(result)) {
+      wait(receiving, not_empty, [this] { return has_value(); });
+    }
     return result;
   }
+
+  bool try_recv(T& val)
+  {
+    if (!pop(val))
+      return false;
+    wake(sending, not_full);
+    return true;
+  }
+
+  // moves all the values available to the end of `out` without blocking, and returns the number of them.
+  std::size_t recv_all(std::vector<T>& out)
+  {
+    std::size_t count = 0;
+    for (T val; pop(val); ++count) {
+      out.push_back(std::move(val));
+    }
+    if (count > 0)
+      wake(sending, not_full);
+    return count;
+  }
+
+  // called when the receiver has gone. senders drop their values from now on rather than wait for room.
+  void close()
+  {
+    closed.store(true);
+    std::lock_guard<std::mutex> lock{m};
+    not_full.notify_all();
+  }
+
+private:
+  static std::size_t round_up(std::size_t n)
+  {
+    std::size_t r = 2;
+    while (r < n)
+      r <<= 1;
+    return r;
+  }
+
+  // moves `val` into the ring, or leaves it as it is if the ring is full.
+  bool push(T& val)
+  {
+    std::size_t pos = tail.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells[pos & mask];
+      std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+      if (diff == 0) {
+        if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0) {
+        return false;
+      }
+      else {
+        pos = tail.load(std::memory_order_relaxed);
+      }
+    }
+    new (cell->storage) T(std::move(val));
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T& val)
+  {
+    Cell& cell = cells[head & mask];
+    if (cell.sequence.load(std::memory_order_acquire) != head + 1)
+      return false;
+    val = std::move(*cell.value());
+    cell.value()->~T();
+    cell.sequence.store(head + mask + 1, std::memory_order_release);
+    ++head;
+    return true;
+  }
+
+  bool has_value() const { return cells[head & mask].sequence.load(std::memory_order_acquire) == head + 1; }
+
+  bool has_room() const
+  {
+    std::size_t pos = tail.load(std::memory_order_relaxed);
+    return cells[pos & mask].sequence.load(std::memory_order_acquire) == pos;
+  }
+
+  // a waiter raises its flag before it checks `ready`, and the other side checks the flag after updating the ring,
+  // with a full fence on both sides so that at least one of them sees the other.
+  // the flag is cleared by the first wake, so that the following ones do not take the lock until it sleeps again.
+  template <typename Pred>
+  void wait(std::atomic<bool>& sleeping, std::condition_variable& cv, Pred ready)
+  {
+    std::unique_lock<std::mutex> lock{m};
+    while (true) {
+      sleeping.store(true);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (ready())
+        return;
+      cv.wait(lock);
+    }
+  }
+
+  void wake(std::atomic<bool>& sleeping, std::condition_variable& cv)
+  {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed) && sleeping.exchange(false)) {
+      std::lock_guard<std::mutex> lock{m};
+      cv.notify_all();
+    }
+  }
 };
 
 template <typename T>
@@ -49,7 +209,7 @@ public:
   void send()
   {
     if (ch)
-      ch->send({});
+      ch->send(T{});
   }
   void send(T const& val)
   {
@@ -59,7 +219,7 @@ public:
   void send(T&& val)
   {
     if (ch)
-      ch->send(val);
+      ch->send(std::move(val));
   }
 };
 
@@ -72,7 +232,13 @@ public:
   receiver(receiver const&) = delete;
   receiver(receiver&&) noexcept = default;
   receiver& operator=(receiver const&) noexcept = delete;
-  receiver& operator=(receiver&&) noexcept = default;
+  receiver& operator=(receiver&& other) noexcept
+  {
+    reset();
+    ch = std::move(other.ch);
+    return *this;
+  }
+  ~receiver() { reset(); }
 
   receiver(std::shared_ptr<channel<T>> ch) : ch{std::move(ch)} {}
 
@@ -82,12 +248,32 @@ public:
       throw std::logic_error("");
     return ch->recv();
   }
+
+  // receives a value without blocking. returns false if no value is available.
+  bool try_recv(T& val) { return ch && ch->try_recv(val); }
+
+  // receives all the values available without blocking into the end of `out`, and returns the number of them.
+  std::size_t recv_all(std::vector<T>& out) { return ch ? ch->recv_all(out) : 0; }
+
+  // the notifier the channel was made with, or nullptr.
+  std::shared_ptr<Notifier> get_notifier() const { return ch ? ch->get_notifier() : nullptr; }
+
+  explicit operator bool() const noexcept { return static_cast<bool>(ch); }
+
+private:
+  // senders never block on a channel nobody receives from.
+  void reset()
+  {
+    if (ch)
+      ch->close();
+    ch.reset();
+  }
 };
 
 template <typename T>
-auto make_channel()
+auto make_channel(std::shared_ptr<Notifier> notifier = nullptr, std::size_t capacity = default_channel_capacity)
 {
-  auto ch = std::make_shared<channel<T>>();
+  auto ch = std::make_shared<channel<T>>(std::move(notifier), capacity);
   return std::make_tuple(sender<T>{ch}, receiver<T>{ch});
 }
 
@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <poll.h>
+#include <thread>
+#include <vector>
+#include "channel.hh"
+
+TEST(channel_test, in_order)
+{
+  sender<int> tx;
+  receiver<int> rx;
+  std::tie(tx, rx) = make_channel<int>(nullptr, 4);
+
+  tx.send(1);
+  tx.send(2);
+  EXPECT_EQ(1, rx.recv());
+
+  int val = 0;
+  EXPECT_TRUE(rx.try_recv(val));
+  EXPECT_EQ(2, val);
+  EXPECT_FALSE(rx.try_recv(val));
+}
+
+TEST(channel_test, move_only)
+{
+  sender<std::unique_ptr<int>> tx;
+  receiver<std::unique_ptr<int>> rx;
+  std::tie(tx, rx) = make_channel<std::unique_ptr<int>>();
+
+  tx.send(std::make_unique<int>(42));
+  EXPECT_EQ(42, *rx.recv());
+}
+
+TEST(channel_test, senders_wait_for_room)
+{
+  sender<int> tx;
+  receiver<int> rx;
+  std::tie(tx, rx) = make_channel<int>(nullptr, 8);
+
+  constexpr int num_senders = 4, count = 10000;
+  std::vector<std::thread> senders;
+  for (int s = 0; s < num_senders; ++s) {
+    senders.emplace_back([tx, s]() mutable {
+      for (int i = 0; i < count; ++i) {
+        tx.send(s * count + i);
+      }
+    });
+  }
+
+  // values of each sender arrive in the order they are sent.
+  std::vector<int> last(num_senders, -1), received;
+  std::size_t total = 0;
+  while (total < num_senders * count) {
+    received.clear();
+    if (rx.recv_all(received) == 0) {
+      received.push_back(rx.recv());
+    }
+    for (int val : received) {
+      EXPECT_LT(last[val / count], val % count);
+      last[val / count] = val % count;
+    }
+    total += received.size();
+  }
+  for (auto& th : senders) {
+    th.join();
+  }
+  EXPECT_EQ(std::vector<int>(num_senders, count - 1), last);
+}
+
+TEST(channel_test, closed_by_receiver)
+{
+  sender<int> tx;
+  receiver<int> rx;
+  std::tie(tx, rx) = make_channel<int>(nullptr, 2);
+
+  std::thread th([tx]() mutable {
+    for (int i = 0; i < 100; ++i) {
+      tx.send(i);
+    }
+  });
+  EXPECT_EQ(0, rx.recv());
+  // the sender stops waiting for room.
+  rx = receiver<int>{};
+  th.join();
+}
+
+TEST(channel_test, notifier_never_loses_wakeups)
+{
+  Notifier notifier;
+  constexpr std::size_t count = 200000;
+  std::atomic<std::size_t> notified{0};
+  std::thread th([&] {
+    for (std::size_t i = 1; i <= count; ++i) {
+      notified.store(i);
+      notifier.notify();
+    }
+  });
+
+  // every notification is seen, either by the check after a drain or by the wakeup following it.
+  for (std::size_t seen = 0; seen < count;) {
+    pollfd pfd{notifier.fd(), POLLIN, 0};
+    ASSERT_EQ(1, ::poll(&pfd, 1, 5000)) << "seen " << seen;
+    notifier.drain();
+    seen = notified.load();
+  }
+  th.join();
+}
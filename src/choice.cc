@@ -0,0 +1,52 @@
+#include "choice.hh"
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+// below this, sorting by comparison is faster than the passes of radix sort.
+constexpr std::size_t min_radix_size = 65536;
+
+// keys are sorted 16 bits at a time, whose counts fit in the L2 cache.
+constexpr int digit_bits = 16;
+constexpr int num_digits = 64 / digit_bits;
+constexpr std::uint64_t digit_mask = (1 << digit_bits) - 1;
+
+void rank_choices(std::vector<Choice>::iterator first, std::vector<Choice>::iterator last)
+{
+  std::size_t const n = last - first;
+  if (n < min_radix_size) {
+    std::sort(first, last, [](Choice const& a, Choice const& b) { return a > b; });
+    return;
+  }
+
+  std::vector<std::uint64_t> keys(n), buf(n);
+  std::vector<std::array<std::uint32_t, 1 << digit_bits>> counts(num_digits);
+  for (std::size_t i = 0; i < n; ++i) {
+    std::uint64_t key = first[i].rank_key();
+    keys[i] = key;
+    for (int d = 0; d < num_digits; ++d) {
+      ++counts[d][(key >> (d * digit_bits)) & digit_mask];
+    }
+  }
+
+  // a digit which is the same in all keys, e.g. the upper bits of indices, does not need a pass.
+  for (int d = 0; d < num_digits; ++d) {
+    auto& count = counts[d];
+    if (std::find(count.begin(), count.end(), n) != count.end()) {
+      continue;
+    }
+    std::uint32_t offset = 0;
+    for (auto& c : count) {
+      offset += std::exchange(c, offset);
+    }
+    for (std::uint64_t key : keys) {
+      buf[count[(key >> (d * digit_bits)) & digit_mask]++] = key;
+    }
+    keys.swap(buf);
+  }
+
+  for (std::size_t i = 0; i < n; ++i) {
+    first[i] = Choice::from_rank_key(keys[i]);
+  }
+}
@@ -2,17 +2,50 @@
 #define __HEADER_CHOICE__
 
 #include <cstdint>
+#include <cstring>
+#include <vector>
 
+// a line matched by a filter, packed into 8 bytes as there may be millions of them.
 struct Choice {
-  std::size_t index;
-  double score = 0;
-  bool selected = false;
+  std::uint32_t index;
+  float score = 0;
 
 public:
   Choice() = default;
-  Choice(std::size_t index) : index(index) {}
+  Choice(std::size_t index) : index(static_cast<std::uint32_t>(index)) {}
 
-  bool operator>(Choice const& rhs) const { return score > rhs.score; }
+  // ranks by descending score, and by input order among equal scores.
+  bool operator>(Choice const& rhs) const
+  {
+    return score > rhs.score || (score == rhs.score && index < rhs.index);
+  }
+
+  // a key which orders choices as operator> does when compared as unsigned integers, i.e. smaller keys rank first.
+  // the upper half is the score with its bits flipped so that higher scores give smaller keys, and the lower half
+  // is the index.
+  std::uint64_t rank_key() const noexcept
+  {
+    // -0 and +0 are equal.
+    float normalized = score + 0.0f;
+    std::uint32_t bits;
+    std::memcpy(&bits, &normalized, sizeof(bits));
+    // the order of IEEE 754 floats as unsigned integers, reversed.
+    bits = (bits & 0x80000000u) ? bits : ~bits & 0x7FFFFFFFu;
+    return (std::uint64_t{bits} << 32) | index;
+  }
+
+  static Choice from_rank_key(std::uint64_t key) noexcept
+  {
+    Choice choice;
+    std::uint32_t bits = static_cast<std::uint32_t>(key >> 32);
+    bits = (bits & 0x80000000u) ? bits : ~bits & 0x7FFFFFFFu;
+    std::memcpy(&choice.score, &bits, sizeof(bits));
+    choice.index = static_cast<std::uint32_t>(key);
+    return choice;
+  }
 };
 
-#endif
\ No newline at end of file
+// sorts choices in the order of operator>, by LSD radix sort on their rank keys.
+void rank_choices(std::vector<Choice>::iterator first, std::vector<Choice>::iterator last);
+
+#endif
@@ -0,0 +1,44 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "choice.hh"
+
+TEST(choice_test, rank_key)
+{
+  Choice a{1}, b{2}, c{3};
+  a.score = 0.5f;
+  b.score = 0.5f;
+  c.score = 2.0f;
+  EXPECT_LT(c.rank_key(), a.rank_key());
+  EXPECT_LT(a.rank_key(), b.rank_key());
+
+  c.score = -1.0f;
+  EXPECT_LT(a.rank_key(), c.rank_key());
+
+  auto d = Choice::from_rank_key(b.rank_key());
+  EXPECT_EQ(b.index, d.index);
+  EXPECT_EQ(b.score, d.score);
+}
+
+TEST(choice_test, rank_choices)
+{
+  std::mt19937 rng(1);
+  for (std::size_t n : {10, 1000, 100000}) {
+    std::vector<Choice> choices(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      choices[i] = Choice(rng() % (n * 4));
+      // few distinct scores, so that ties are broken by index.
+      choices[i].score = static_cast<float>(rng() % 50) / 7 - 3;
+    }
+    auto expected = choices;
+    std::sort(expected.begin(), expected.end(), [](Choice const& a, Choice const& b) { return a > b; });
+
+    rank_choices(choices.begin(), choices.end());
+    for (std::size_t i = 0; i < n; ++i) {
+      ASSERT_EQ(expected[i].index, choices[i].index);
+      ASSERT_EQ(expected[i].score, choices[i].score);
+    }
+  }
+}
@@ -7,7 +7,6 @@
 #include <regex>
 #include <stdexcept>
 #include <string>
-#include <thread>
 #include <tuple>
 #include <vector>
 
@@ -26,6 +25,7 @@ enum class Coco::Status {
   Escaped,
   Updated,
   Skip,
+  Idle,
 };
 
 enum class Coco::Keymap {
@@ -37,6 +37,7 @@ enum class Coco::Keymap {
   RotateFilter,
   PopQuery,
   PushQuery,
+  Resize,
   Unknown,
 };
 
@@ -49,19 +50,51 @@ void Config::parse_args(int argc, char const** argv)
   parser.add("help", 'h', "print this message");
   parser.add<std::string>("query", 'q', "initial value for query", false, "");
   parser.add<std::string>("prompt", 'p', "specify the prompt string", false, "QUERY> ");
-  parser.add<std::size_t>("max-buffer", 'b', "maximum length of lines", false, 4096);
-  //  parser.add<double>("score-min", 's', "threshold of score", false, 0.01);
+  parser.add<std::size_t>("max-buffer", 'b', "maximum length of lines", false, 10000000);
+  parser.add<double>("score-min", 's', "threshold of score (not applied to Fuzzy)", false, 0.01);
   parser.add<std::string>("filter", 'f', "type of filter", false, "SmartCase",
-                          cmdline::oneof<std::string>("CaseSensitive", "SmartCase", "Regex"));
+                          cmdline::oneof<std::string>("CaseSensitive", "SmartCase", "Regex", "Fuzzy"));
   parser.add("select-one", 0, "Skip prompting if the number of candidates is one or zero");
+  parser.add<std::size_t>("threads", 'j', "number of threads used for filtering (0: auto)", false, 0);
+  parser.add("folded-copy", 0, "keep a lower-cased copy of lines to speed up case-insensitive filtering");
+  parser.add("frame-bytes", 0,
+             "also show the number of bytes written to the terminal by the last frame (implies --stats)");
+  parser.add("stats", 0, "record the latency of each stage, show the last frame time and report them on exit");
+  parser.add<std::string>("stats-file", 0, "file to write the report of --stats to, instead of stderr", false, "");
+  parser.add<std::string>("batch", 0, "print the lines matched by the query without prompting", false, "");
+  parser.add<std::size_t>("limit", 0, "maximum number of lines printed by --batch (0: no limit)", false, 0);
+  parser.add("no-sort", 0, "print the lines matched by --batch in input order, even if they are ranked");
+  parser.add("index", 0, "search the file through a trigram index kept next to it, which is built if out of date");
+  parser.add<std::size_t>("index-memory", 0, "MiB of memory for indexing large inputs in background (0: no index)",
+                          false, 256);
+  parser.add<std::size_t>("cache-memory", 0, "MiB of memory for the results of recent queries (0: no cache)", false,
+                          64);
   parser.footer("filename...");
   parser.parse_check(argc, argv);
 
   query = parser.get<std::string>("query");
   prompt = parser.get<std::string>("prompt");
-  // score_min = parser.get<double>("score-min");
+  score_min = parser.get<double>("score-min");
   max_buffer = parser.get<std::size_t>("max-buffer");
   select_one = parser.exist("select-one");
+  num_threads = parser.get<std::size_t>("threads");
+  folded_copy = parser.exist("folded-copy");
+  frame_bytes = parser.exist("frame-bytes");
+  stats_file = parser.get<std::string>("stats-file");
+  stats = parser.exist("stats") || !stats_file.empty() || frame_bytes;
+  batch = parser.exist("batch");
+  if (batch) {
+    query = parser.get<std::string>("batch");
+    // lines are not kept in batch mode, so the input is read to the end unless limited explicitly.
+    if (!parser.exist("max-buffer")) {
+      max_buffer = static_cast<std::size_t>(-1);
+    }
+  }
+  limit = parser.get<std::size_t>("limit");
+  sorted = !parser.exist("no-sort");
+  use_index = parser.exist("index");
+  index_memory = parser.get<std::size_t>("index-memory") << 20;
+  cache_memory = parser.get<std::size_t>("cache-memory") << 20;
 
   std::stringstream ss{parser.get<std::string>("filter")};
   ss >> filter_mode;
@@ -71,42 +104,190 @@ void Config::parse_args(int argc, char const** argv)
   }
 }
 
-Choices::Choices(arc<std::vector<std::string>> lines, receiver<bool> rx, double score_min)
-    : lines(lines), rx(std::move(rx)), score_min(score_min)
+Choices::Choices(std::shared_ptr<LineStore> lines, receiver<bool> rx, double score_min, std::size_t num_threads,
+                 bool use_folded, std::shared_ptr<LineIndex const> index, std::size_t index_memory,
+                 std::size_t cache_memory)
+    : lines(lines), rx(std::move(rx)), index_memory(index_memory)
 {
-  choices.resize(lines.read().get().size());
-  std::generate(choices.begin(), choices.end(), [n = 0]() mutable { return Choice(n++); });
-  filtered_len = choices.size();
+  eof = !this->rx;
+
+  // filtered choices wake up the event loop as well as received lines.
+  wakeup = this->rx.get_notifier();
+  if (!wakeup) {
+    wakeup = std::make_shared<Notifier>();
+  }
+  sender<FilterUpdate> tx;
+  std::tie(tx, updates) = make_channel<FilterUpdate>(wakeup);
+  worker = std::make_unique<FilterWorker>(lines, std::move(tx), score_min, num_threads, use_folded, std::move(index),
+                                          cache_memory);
 }
 
 void Choices::apply_filter(FilterMode mode, std::string const& query)
 {
-  try {
-    auto scorer = score_by(mode, query);
-    scorer->scoring(choices, lines.read().get());
-    filtered_len =
-        std::find_if(choices.begin(), choices.end(), [=](auto& choice) { return choice.score <= score_min; }) -
-        choices.begin();
+  generation = worker->request(mode, query);
+  done = false;
+  since_request.restart();
+  scoring_seconds = 0;
+  last_mode = mode;
+  last_query = query;
+}
+
+bool Choices::fetch()
+{
+  // drained first, so that anything sent while receiving leaves the notifier readable.
+  wakeup->drain();
+
+  batches.clear();
+  bool received = rx.recv_all(batches) > 0;
+  for (bool more : batches) {
+    if (!more && !eof) {
+      finish_loading();
+    }
+  }
+  if (received) {
+    worker->notify_lines();
+  }
+
+  pending.clear();
+  bool updated = updates.recv_all(pending) > 0;
+  for (auto& update : pending) {
+    apply_update(std::move(update));
+  }
+  return received || updated;
+}
+
+void Choices::fetch_all()
+{
+  while (!eof) {
+    if (!rx.recv()) {
+      finish_loading();
+    }
   }
-  catch (std::regex_error&) {
+  if (generation == 0) {
+    return;
   }
 
-  // mark hidden choices unselected.
-  for (size_t i = filtered_len; i < choices.size(); ++i) {
-    choices[i].selected = false;
+  // filter again, which only scans the lines the current result has not covered yet.
+  apply_filter(last_mode, last_query);
+  wait_filter();
+}
+
+void Choices::wait_filter()
+{
+  while (!done) {
+    apply_update(updates.recv());
   }
 }
 
-std::vector<std::string> Choices::get_selection(std::size_t idx)
+// inputs smaller than this are scanned fast enough without an index.
+constexpr std::size_t min_indexed_lines = 100000;
+
+void Choices::finish_loading()
 {
-  std::vector<std::string> candidates;
-  for (std::size_t i = 0; i < filtered_len; ++i) {
-    if (choices[i].selected)
-      candidates.push_back(lines.read().get()[choices[i].index]);
+  eof = true;
+  if (index_memory > 0 && lines->size() >= min_indexed_lines) {
+    worker->start_indexing(index_memory);
   }
+  if (stats) {
+    stats->finish_ingest(lines->size());
+  }
+}
+
+void Choices::apply_update(FilterUpdate update)
+{
+  // updates of cancelled queries may still come.
+  if (update.generation != generation) {
+    return;
+  }
+  scoring_seconds += update.seconds;
 
-  if (candidates.empty() && filtered_len > 0) {
-    return {lines.read().get()[choices[idx].index]};
+  if (update.reset) {
+    choices = std::move(update.choices);
+    ranked = update.ranked;
+  }
+  else {
+    choices.insert(choices.end(), update.choices.begin(), update.choices.end());
+  }
+  // new matches may outrank the ones already sorted.
+  sorted_len = ranked ? 0 : choices.size();
+
+  if (update.done && !done) {
+    done = true;
+    if (stats) {
+      stats->record(Stats::Filter, since_request.elapsed());
+      stats->record(Stats::Scoring, scoring_seconds);
+    }
+    if (num_selected > 0) {
+      std::vector<bool> visible(selected.size());
+      num_selected = 0;
+      for (auto& choice : choices) {
+        if (choice.index < selected.size() && selected[choice.index]) {
+          visible[choice.index] = true;
+          ++num_selected;
+        }
+      }
+      selected.swap(visible);
+    }
+  }
+}
+
+bool Choices::is_selected(std::size_t index)
+{
+  auto i = at(index).index;
+  return i < selected.size() && selected[i];
+}
+
+void Choices::toggle_selection(std::size_t index)
+{
+  if (index >= choices.size()) {
+    return;
+  }
+  auto i = at(index).index;
+  if (i >= selected.size()) {
+    selected.resize(i + 1);
+  }
+  selected[i] = !selected[i];
+  num_selected += selected[i] ? 1 : -1;
+}
+
+// number of choices ranked first, which is enough for a screen.
+constexpr std::size_t rank_page_size = 256;
+
+Choice& Choices::at(std::size_t index)
+{
+  if (index >= sorted_len) {
+    Stopwatch watch;
+    // the first page is picked out of the rest, and going beyond it ranks all the rest at once.
+    if (sorted_len == 0 && index < rank_page_size) {
+      auto mid = std::min(choices.size(), rank_page_size);
+      std::partial_sort(choices.begin(), choices.begin() + mid, choices.end(), std::greater<Choice>{});
+      sorted_len = mid;
+    }
+    else {
+      rank_choices(choices.begin() + sorted_len, choices.end());
+      sorted_len = choices.size();
+    }
+    if (stats) {
+      stats->record(Stats::Ranking, watch.elapsed());
+    }
+  }
+  return choices[index];
+}
+
+std::vector<std::string_view> Choices::get_selection(std::size_t idx)
+{
+  auto snapshot = this->snapshot();
+
+  std::vector<std::string_view> candidates;
+  if (num_selected > 0) {
+    for (auto& choice : choices) {
+      if (choice.index < selected.size() && selected[choice.index])
+        candidates.push_back(snapshot.store()[choice.index]);
+    }
+  }
+
+  if (candidates.empty() && idx < choices.size()) {
+    return {snapshot.line(idx)};
   }
   else {
     return candidates;
@@ -117,68 +298,194 @@ Coco::Coco(Config const& config, Choices choices) : config(config), choices(std:
 {
   query = config.query;
   filter_mode = config.filter_mode;
+  if (config.stats) {
+    stats = std::make_unique<Stats>();
+    this->choices.set_stats(stats.get());
+  }
 
   update_filter_list();
 }
 
-std::vector<std::string> Coco::select_line()
+std::vector<std::string_view> Coco::select_line()
 {
-  if (config.select_one && choices.size() <= 1) {
-    return choices.get_selection(0);
+  if (config.select_one) {
+    choices.fetch_all();
+    if (choices.size() <= 1) {
+      return choices.get_selection(0);
+    }
   }
 
   // initialize ncurses screen.
   Window term;
   render_screen(term);
 
-  // event loop.
+  // event loop. it sleeps in poll() until a key is pressed or the reader appends lines.
   while (true) {
-    auto result = handle_key_event(term);
-
-    if (result == Status::Selected) {
-      return choices.get_selection(cursor + offset);
+    term.wait_event(choices.wakeup_fd());
+
+    bool updated = false;
+    Stopwatch watch;
+    for (Status result; (result = handle_key_event(term)) != Status::Idle; watch.restart()) {
+      if (stats) {
+        stats->record(Stats::Key, watch.elapsed());
+      }
+      if (result == Status::Selected) {
+        // the selection is made from the result of the query typed so far.
+        choices.wait_filter();
+        clamp_cursor();
+        return choices.get_selection(cursor + offset);
+      }
+      else if (result == Status::Escaped) {
+        return {};
+      }
+      updated |= (result == Status::Updated);
     }
-    else if (result == Status::Escaped) {
-      break;
+    if (choices.fetch()) {
+      updated = true;
     }
-    else if (result == Status::Updated) {
+    clamp_cursor();
+    if (updated) {
       render_screen(term);
     }
+  }
+  return {};
+}
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+void Coco::report_stats(std::ostream& os) const
+{
+  if (stats) {
+    stats->report(os);
   }
+}
 
-  return {};
+// copies the part of `line` which fits in `width` columns to `out`, with tabs expanded to spaces.
+static void clip_line(std::string_view line, std::size_t width, std::string& out)
+{
+  constexpr std::size_t tab_width = 8;
+
+  std::size_t col = 0;
+  while (col < width) {
+    auto tab = line.find('\t');
+    auto part = line.substr(0, tab);
+    std::size_t used;
+    auto clipped = clip_to_width(part, width - col, used);
+    out.append(clipped);
+    col += used;
+    if (clipped.size() < part.size() || tab == std::string_view::npos) {
+      break;
+    }
+    std::size_t stop = std::min(width, (col / tab_width + 1) * tab_width);
+    out.append(stop - col, ' ');
+    col = stop;
+    line.remove_prefix(tab + 1);
+  }
 }
 
 void Coco::render_screen(Window& term)
 {
-  term.erase();
-
+  Stopwatch watch;
   int width, height;
   std::tie(width, height) = term.get_size();
 
-  for (size_t y = 0; y < std::min<size_t>(choices.size() - offset, height - 1); ++y) {
-    if (choices.is_selected(y + offset)) {
-      term.add_str(0, y + y_offset, ">");
+  // a resized screen is drawn from scratch.
+  if (width != frame_width || frame.size() != static_cast<size_t>(height)) {
+    term.erase();
+    frame.assign(height, Row{});
+    frame_width = width;
+  }
+
+  // the lines are read through one snapshot, and the rows are built in buffers kept across frames.
+  auto snapshot = choices.snapshot();
+  Row& row = scratch;
+  for (int y = y_offset; y < height; ++y) {
+    std::size_t index = y - y_offset + offset;
+    row.text.clear();
+    row.selected = false;
+    row.highlighted = false;
+    if (index < choices.size()) {
+      clip_line(snapshot.line(index), std::max(0, width - 2), row.text);
+      row.selected = choices.is_selected(index);
+      row.highlighted = (y - y_offset == cursor);
     }
-    term.add_str(2, y + 1, choices.line(y + offset));
+    draw_row(term, 2, y, row);
+  }
 
-    if (y == cursor) {
-      term.change_attr(0, y + 1, -1, 0);
+  status.clear();
+  if (choices.filtering()) {
+    status += "filtering... ";
+  }
+  if (choices.indexing()) {
+    status += "indexing... ";
+  }
+  else if (auto indexed = choices.indexed_lines()) {
+    status += "indexed ";
+    if (indexed < snapshot.total()) {
+      status += std::to_string(indexed * 100 / snapshot.total());
+      status += "% ";
     }
   }
+  status += to_string(filter_mode);
+  status += " [";
+  status += std::to_string(cursor + offset);
+  status += "/";
+  status += std::to_string(choices.size());
+  status += "] ";
+  if (stats) {
+    char frame_time[32];
+    std::snprintf(frame_time, sizeof(frame_time), "%.1fms ", stats->last(Stats::Render) * 1e3);
+    status += frame_time;
+  }
+  status += "(";
+  status += std::to_string(snapshot.total());
+  status += choices.loading() ? " lines...)" : " lines)";
+  if (config.frame_bytes) {
+    status += frame_bytes_known ? " " + std::to_string(last_frame_bytes) + "B" : " n/a";
+  }
 
-  std::string query_str = config.prompt + query;
+  // the status is put on the right of the query if there is room for it.
+  std::size_t prompt_width, query_width;
+  row.text = clip_to_width(config.prompt, std::max(0, width), prompt_width);
+  row.text += clip_to_width(query, std::max(0, width) - prompt_width, query_width);
+  query_width += prompt_width;
+  row.selected = false;
+  row.highlighted = false;
+  std::size_t status_width;
+  clip_to_width(status, status.size(), status_width);
+  if (query_width + status_width < static_cast<size_t>(std::max(0, width - 1))) {
+    row.text.append(width - 1 - status_width - query_width, ' ');
+    row.text += status;
+  }
+  draw_row(term, 0, 0, row);
+  term.move_cursor(query_width, 0);
 
-  std::stringstream ss;
-  ss << filter_mode << " [" << cursor + offset << "/" << choices.size() << "]";
-  std::string mode_str = ss.str();
+  term.refresh();
+  if (stats) {
+    stats->record(Stats::Render, watch.elapsed());
+  }
+  // read once per frame, after the render time is taken. nothing else writes to the terminal between frames.
+  if (config.frame_bytes) {
+    std::size_t bytes = 0;
+    frame_bytes_known = term.bytes_written(bytes);
+    last_frame_bytes = bytes - frame_bytes_total;
+    frame_bytes_total = bytes;
+  }
+}
 
-  term.add_str(width - 1 - mode_str.length(), 0, mode_str);
-  term.add_str(0, 0, query_str);
+void Coco::draw_row(Window& term, int x, int y, Row const& row)
+{
+  if (frame[y] == row) {
+    return;
+  }
 
-  term.refresh();
+  term.clear_line(0, y);
+  if (row.selected) {
+    term.add_str(0, y, ">");
+  }
+  term.add_str(x, y, row.text);
+  if (row.highlighted) {
+    term.change_attr(0, y, -1, 0);
+  }
+  frame[y] = row;
 }
 
 auto Coco::apply_keymap(Event ev, std::string& ch) -> Keymap
@@ -205,6 +512,9 @@ auto Coco::apply_keymap(Event ev, std::string& ch) -> Keymap
     ch = ev.as_chars();
     return Keymap::PushQuery;
   }
+  else if (ev == Key::Resize) {
+    return Keymap::Resize;
+  }
   else if (ev == Key::Ctrl) {
     if (ev.get_mod() == 'r') {
       return Keymap::RotateFilter;
@@ -215,8 +525,13 @@ auto Coco::apply_keymap(Event ev, std::string& ch) -> Keymap
 
 auto Coco::handle_key_event(Window& term) -> Status
 {
+  auto ev = term.poll_event();
+  if (ev == Key::None) {
+    return Status::Idle;
+  }
+
   std::string ch;
-  auto keymap = apply_keymap(term.poll_event(), ch);
+  auto keymap = apply_keymap(ev, ch);
 
   switch (keymap) {
   case Keymap::FinishSelectition:
@@ -241,8 +556,8 @@ auto Coco::handle_key_event(Window& term) -> Status
     if (cursor == static_cast<size_t>(height - 1 - y_offset)) {
       offset = std::min<size_t>(offset + 1, std::max<int>(0, choices.size() - height + y_offset));
     }
-    else {
-      cursor = std::min<size_t>(cursor + 1, std::min<size_t>(choices.size() - offset, height - y_offset) - 1);
+    else if (cursor + offset + 1 < choices.size()) {
+      cursor = std::min<size_t>(cursor + 1, height - 1 - y_offset);
     }
     return Status::Updated;
   }
@@ -263,8 +578,16 @@ auto Coco::handle_key_event(Window& term) -> Status
     return Status::Updated;
   }
 
+  case Keymap::Resize: {
+    // keep the cursor on the screen.
+    int height;
+    std::tie(std::ignore, height) = term.get_size();
+    cursor = std::min<size_t>(cursor, std::max<int>(0, height - 1 - y_offset));
+    return Status::Updated;
+  }
+
   case Keymap::RotateFilter: {
-    filter_mode = static_cast<FilterMode>((static_cast<int>(filter_mode) + 1) % 3);
+    filter_mode = static_cast<FilterMode>((static_cast<int>(filter_mode) + 1) % num_filter_modes);
     update_filter_list();
     return Status::Updated;
   }
@@ -281,3 +604,18 @@ void Coco::update_filter_list()
   cursor = 0;
   offset = 0;
 }
+
+// keeps the cursor on a choice, as a new result may have fewer choices than the one it was moved over.
+void Coco::clamp_cursor()
+{
+  std::size_t const num_choices = choices.size();
+  if (cursor + offset < num_choices) {
+    return;
+  }
+  if (num_choices == 0) {
+    cursor = offset = 0;
+    return;
+  }
+  offset = std::min(offset, num_choices - 1);
+  cursor = num_choices - 1 - offset;
+}
@@ -3,12 +3,17 @@
 
 #include <cstdio>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include "filter.hh"
+#include "filter_worker.hh"
+#include "line_store.hh"
 #include "choice.hh"
-#include "arc.hh"
 #include "channel.hh"
+#include "notifier.hh"
+#include "stats.hh"
 
 namespace curses {
 class Window;
@@ -23,31 +28,110 @@ struct Config {
   FilterMode filter_mode;
   std::string file;
   bool select_one;
+  std::size_t num_threads;
+  bool folded_copy;
+  bool frame_bytes;
+  bool stats;
+  std::string stats_file; // empty for stderr.
+  bool batch;             // filters with `query` and prints the matches without a terminal.
+  std::size_t limit;
+  bool sorted;
+  bool use_index;
+  std::size_t index_memory; // in bytes.
+  std::size_t cache_memory; // in bytes.
 
 public:
   Config() = default;
   void parse_args(int argc, char const** argv);
 };
 
+// the candidates shown on the screen.
+// filtering runs on a FilterWorker, and its results are taken by fetch() as they come.
 class Choices {
-  arc<std::vector<std::string>> lines;
+  std::shared_ptr<LineStore> lines;
   receiver<bool> rx;
+  std::shared_ptr<Notifier> wakeup;
+  std::unique_ptr<FilterWorker> worker;
+  // destroyed before the worker, so that it never waits for room to send an update.
+  receiver<FilterUpdate> updates;
+  // buffers which fetch() receives into.
+  std::vector<bool> batches;
+  std::vector<FilterUpdate> pending;
+  bool eof = true;
+  // the memory for an index built once all lines are received, or 0 not to build it.
+  std::size_t index_memory = 0;
 
+  // the choices matched by the latest query so far.
   std::vector<Choice> choices;
-  std::size_t filtered_len = 0;
-  double score_min = 0.01;
+  std::size_t generation = 0;
+  bool done = true;
+  FilterMode last_mode;
+  std::string last_query;
+
+  // matched choices are ranked lazily: only the first `sorted_len` are in their final order.
+  bool ranked = false;
+  std::size_t sorted_len = 0;
+
+  // whether each line is selected, by index. hidden lines are unselected when a query is done.
+  std::vector<bool> selected;
+  std::size_t num_selected = 0;
+
+  // latencies are recorded to it if it is set.
+  Stats* stats = nullptr;
+  Stopwatch since_request;
+  double scoring_seconds = 0;
 
 public:
   Choices() = default;
   Choices(Choices&&) noexcept = default;
-  Choices(arc<std::vector<std::string>> lines, receiver<bool> rx, double score_min);
+  Choices(std::shared_ptr<LineStore> lines, receiver<bool> rx, double score_min, std::size_t num_threads = 1,
+          bool use_folded = false, std::shared_ptr<LineIndex const> index = nullptr, std::size_t index_memory = 0,
+          std::size_t cache_memory = 0);
+
+  // a view of the lines for reading many of them at once, e.g. while a frame is drawn.
+  // lines appended after it is taken are not seen through it.
+  class Snapshot {
+    Choices& choices;
+    LineStore::Snapshot lines;
+
+  public:
+    explicit Snapshot(Choices& choices) : choices{choices}, lines{choices.lines->snapshot()} {}
+
+    // the line of the choice at `index`. views stay valid after the snapshot is released.
+    std::string_view line(std::size_t index) const { return lines[choices.at(index).index]; }
+    LineStore::Snapshot const& store() const noexcept { return lines; }
+    std::size_t total() const noexcept { return lines.size(); }
+  };
+
+  Snapshot snapshot() { return Snapshot{*this}; }
 
-  std::vector<std::string> get_selection(std::size_t index);
+  // the returned views stay valid as long as the lines are alive.
+  std::vector<std::string_view> get_selection(std::size_t index);
+  // starts filtering in background. the current choices are shown until the new ones arrive.
   void apply_filter(FilterMode mode, std::string const& query);
-  bool is_selected(size_t index) { return choices[index].selected; }
-  void toggle_selection(std::size_t index) { choices[index].selected ^= true; }
-  std::size_t size() const noexcept { return filtered_len; }
-  std::string line(std::size_t index) { return lines.read().get()[choices[index].index]; }
+
+  // takes lines received and choices filtered since the last call. returns true if anything has changed.
+  bool fetch();
+  // blocks until all lines are received and filtered.
+  void fetch_all();
+  // blocks until the current query is done with the lines received so far.
+  void wait_filter();
+  bool is_selected(size_t index);
+  // does nothing if `index` is out of the choices.
+  void toggle_selection(std::size_t index);
+  std::size_t size() const noexcept { return choices.size(); }
+  bool loading() const noexcept { return !eof; }
+  bool filtering() const noexcept { return !done; }
+  bool indexing() const noexcept { return worker->indexing(); }
+  std::size_t indexed_lines() const { return worker->indexed_lines(); }
+  // a file descriptor which gets readable when fetch() has something to take.
+  int wakeup_fd() const noexcept { return wakeup->fd(); }
+  void set_stats(Stats* stats) noexcept { this->stats = stats; }
+
+private:
+  void apply_update(FilterUpdate update);
+  void finish_loading();
+  Choice& at(std::size_t index);
 };
 
 // represents a instance of Coco client.
@@ -63,14 +147,42 @@ class Coco {
   std::size_t cursor = 0;
   std::size_t offset = 0;
 
+  // a row of the screen. rows are redrawn only if they differ from the ones drawn last time.
+  struct Row {
+    std::string text; // clipped to the width of the screen, with tabs expanded.
+    bool selected = false;
+    bool highlighted = false;
+
+    bool operator==(Row const& r) const
+    {
+      return text == r.text && selected == r.selected && highlighted == r.highlighted;
+    }
+  };
+  std::vector<Row> frame;
+  int frame_width = -1;
+  std::size_t last_frame_bytes = 0;
+  std::size_t frame_bytes_total = 0; // as of the end of the last frame.
+  bool frame_bytes_known = false;
+  // buffers reused by every frame.
+  Row scratch;
+  std::string status;
+
+  std::unique_ptr<Stats> stats;
+
 public:
   Coco(Config const& config, Choices choices);
-  std::vector<std::string> select_line();
+  // the returned views refer to the lines owned by this instance.
+  std::vector<std::string_view> select_line();
+  // writes the latencies recorded with --stats.
+  void report_stats(std::ostream& os) const;
 
 private:
   void render_screen(curses::Window& term);
+  // draws `row` at the line `y` with its text from the column `x`, unless it is already there.
+  void draw_row(curses::Window& term, int x, int y, Row const& row);
   Status handle_key_event(curses::Window& term);
   void update_filter_list();
+  void clamp_cursor();
   Keymap apply_keymap(curses::Event ev, std::string& ch);
 };
 
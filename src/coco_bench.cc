@@ -0,0 +1,305 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cmdline.h>
+#include <picojson.h>
+#include "channel.hh"
+#include "choice.hh"
+#include "filter.hh"
+#include "ingest.hh"
+#include "line_store.hh"
+#include "thread_pool.hh"
+#include "utf8.hh"
+
+// measures the stages of coco on synthetic corpora, and prints the results as JSON.
+// corpora are generated from fixed seeds, so that runs on the same machine can be diffed.
+
+using clock_type = std::chrono::steady_clock;
+
+template <typename F>
+static double seconds(F&& f)
+{
+  auto start = clock_type::now();
+  f();
+  return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+static picojson::value number(double v) { return picojson::value(v); }
+
+// a kind of input, and the query typed into it.
+struct Corpus {
+  std::string name;
+  std::string query;
+  std::function<std::string(std::mt19937&, std::size_t)> line;
+};
+
+static std::vector<Corpus> corpora()
+{
+  static char const* const dirs[] = {"src", "include", "lib", "test", "docs", "build", "vendor", "app", "core", "util"};
+  static char const* const exts[] = {".cc", ".hh", ".py", ".rs", ".md", ".json"};
+  static char const* const levels[] = {"INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR"};
+  static char const* const words[] = {"request", "response", "cache", "miss", "timeout", "retry", "user", "session"};
+  static char const* const cjk[] = {u8"東京",   u8"ファイル", u8"検索",   u8"テスト", u8"日本語", u8"漢字",
+                                    u8"設定", u8"ログ",     u8"サーバ", u8"🍣",     u8"🚀",     u8"✨"};
+
+  auto path = [](std::mt19937& rng, std::size_t) {
+    std::string s;
+    for (int depth = 1 + rng() % 4; depth > 0; --depth) {
+      s += "/";
+      s += dirs[rng() % 10];
+    }
+    s += "/module" + std::to_string(rng() % 1000) + "/name_" + std::to_string(rng() % 100) + exts[rng() % 6];
+    return s;
+  };
+
+  return {
+      {"paths", "module42 name", path},
+      {"logs", "ERROR worker-3",
+       [=](std::mt19937& rng, std::size_t i) {
+         std::string s = "2016-10-17T12:" + std::to_string(10 + i / 60000 % 50) + ":" + std::to_string(10 + i / 1000 % 50) +
+                         "." + std::to_string(100 + i % 900) + "Z " + levels[rng() % 6] + " [worker-" +
+                         std::to_string(rng() % 64) + "] ";
+         for (int n = 2 + rng() % 4; n > 0; --n) {
+           s += words[rng() % 8];
+           s += " ";
+         }
+         return s + "id=" + std::to_string(rng()) + " path=" + path(rng, i);
+       }},
+      {"cjk", u8"検索 テスト",
+       [](std::mt19937& rng, std::size_t) {
+         std::string s;
+         for (int n = 3 + rng() % 8; n > 0; --n) {
+           s += rng() % 3 == 0 ? words[rng() % 8] : cjk[rng() % 12];
+           s += " ";
+         }
+         return s;
+       }},
+  };
+}
+
+static std::string generate(Corpus const& corpus, std::size_t num_lines)
+{
+  std::mt19937 rng(42);
+  std::string text;
+  for (std::size_t i = 0; i < num_lines; ++i) {
+    text += corpus.line(rng, i);
+    text += '\n';
+  }
+  return text;
+}
+
+static picojson::value bench_read_lines(std::string const& text, LineStore& lines)
+{
+  std::size_t count = 0;
+  double sec = seconds([&] {
+    std::istringstream is{text};
+    read_lines(is, static_cast<std::size_t>(-1), [&](LineStore const& batch) {
+      lines.append(batch);
+      count += batch.size();
+    });
+  });
+  return picojson::value(picojson::object{
+      {"seconds", number(sec)}, {"lines_per_sec", number(count / sec)}, {"mb_per_sec", number(text.size() / sec / 1e6)}});
+}
+
+// types the query of the corpus a character at a time. each keystroke scores the survivors of the previous one
+// if the query narrows, as FilterWorker does, and all lines otherwise.
+static picojson::value bench_typing(FilterMode mode, std::string const& query, LineStore const& lines, ThreadPool& pool,
+                                    std::vector<Choice>& broadest)
+{
+  picojson::array keystrokes;
+  double total = 0, worst = 0;
+  std::vector<Choice> choices;
+  std::size_t matched = 0;
+  std::string prev;
+  for (std::size_t len = 0; len < query.size();) {
+    len += get_utf8_char_length(query[len]);
+    std::string q = query.substr(0, len);
+
+    auto filter = score_by(mode, q);
+    double sec = seconds([&] {
+      if (!prev.empty() && is_narrowing(mode, prev, q)) {
+        choices.resize(matched);
+      }
+      else {
+        choices.resize(lines.size());
+        for (std::size_t i = 0; i < choices.size(); ++i) {
+          choices[i] = Choice(i);
+        }
+      }
+      matched = filter->scoring(choices.begin(), choices.end(), lines, pool, 0.01);
+    });
+    prev = q;
+
+    keystrokes.push_back(picojson::value(
+        picojson::object{{"query", picojson::value(q)}, {"ms", number(sec * 1e3)}, {"matched", number(matched)}}));
+    total += sec;
+    worst = std::max(worst, sec);
+    if (len == get_utf8_char_length(query[0])) {
+      broadest.assign(choices.begin(), choices.begin() + matched);
+    }
+  }
+
+  return picojson::value(picojson::object{{"total_ms", number(total * 1e3)},
+                                          {"max_ms", number(worst * 1e3)},
+                                          {"keystrokes", picojson::value(keystrokes)}});
+}
+
+// ranks the lines matched by the first keystroke of a fuzzy query, and picks the first screenful.
+static picojson::value bench_ranking(std::vector<Choice> const& matched)
+{
+  auto choices = matched;
+  double rank = seconds([&] { rank_choices(choices.begin(), choices.end()); });
+
+  choices = matched;
+  std::size_t page = std::min<std::size_t>(choices.size(), 256);
+  double first_page = seconds([&] {
+    std::partial_sort(choices.begin(), choices.begin() + page, choices.end(), std::greater<Choice>{});
+  });
+
+  choices = matched;
+  double stable_sort = seconds([&] { std::stable_sort(choices.begin(), choices.end(), std::greater<Choice>{}); });
+
+  return picojson::value(picojson::object{{"choices", number(matched.size())},
+                                          {"rank_choices_ms", number(rank * 1e3)},
+                                          {"first_page_ms", number(first_page * 1e3)},
+                                          {"stable_sort_ms", number(stable_sort * 1e3)}});
+}
+
+static picojson::value bench_utf8(LineStore const& lines)
+{
+  std::size_t const n = std::min<std::size_t>(lines.size(), 100000);
+  std::size_t chars = 0, sink = 0;
+  double mb_width = seconds([&] {
+    std::string ch;
+    for (std::size_t i = 0; i < n; ++i) {
+      auto line = lines[i];
+      for (std::size_t k = 0; k < line.size();) {
+        std::size_t len = get_utf8_char_length(line[k]);
+        ch.assign(line.substr(k, len));
+        sink += get_mb_width(ch);
+        k += len;
+        ++chars;
+      }
+    }
+  });
+  double clip = seconds([&] {
+    for (std::size_t i = 0; i < n; ++i) {
+      sink += clip_to_width(lines[i], 80).size();
+    }
+  });
+  double fold = seconds([&] {
+    std::string out;
+    for (std::size_t i = 0; i < n; ++i) {
+      out.clear();
+      fold_case_utf8(lines[i], out);
+      sink += out.size();
+    }
+  });
+  return picojson::value(picojson::object{{"lines", number(n)},
+                                          {"get_mb_width_ns_per_char", number(mb_width / chars * 1e9)},
+                                          {"clip_to_width_ns_per_line", number(clip / n * 1e9)},
+                                          {"fold_case_utf8_ns_per_line", number(fold / n * 1e9)},
+                                          {"checksum", number(sink)}});
+}
+
+static picojson::value bench_channel(std::size_t count)
+{
+  sender<std::size_t> tx;
+  receiver<std::size_t> rx;
+  std::tie(tx, rx) = make_channel<std::size_t>();
+
+  std::size_t sum = 0;
+  double sec = seconds([&] {
+    std::thread th([&] {
+      for (std::size_t i = 0; i < count; ++i) {
+        tx.send(i);
+      }
+    });
+    std::vector<std::size_t> batch;
+    for (std::size_t received = 0; received < count;) {
+      batch.clear();
+      if (rx.recv_all(batch) == 0) {
+        batch.push_back(rx.recv());
+      }
+      for (auto v : batch) {
+        sum += v;
+      }
+      received += batch.size();
+    }
+    th.join();
+  });
+  return picojson::value(picojson::object{{"messages", number(count)}, {"messages_per_sec", number(count / sec)}});
+}
+
+int main(int argc, char const** argv)
+{
+  cmdline::parser parser;
+  parser.set_program_name("coco_bench");
+  parser.add<std::string>("sizes", 'n', "comma-separated numbers of lines of each corpus", false, "10000,1000000");
+  parser.add<std::string>("corpus", 'c', "corpus to run, or all", false, "all",
+                          cmdline::oneof<std::string>("all", "paths", "logs", "cjk"));
+  parser.add<std::size_t>("threads", 'j', "number of threads used for filtering (0: auto)", false, 1);
+  parser.add<std::string>("output", 'o', "file to write the results to, instead of stdout", false, "");
+  parser.parse_check(argc, argv);
+
+  std::vector<std::size_t> sizes;
+  std::istringstream iss{parser.get<std::string>("sizes")};
+  for (std::string size; std::getline(iss, size, ',');) {
+    sizes.push_back(std::stoul(size));
+  }
+  std::string const only = parser.get<std::string>("corpus");
+  ThreadPool pool{parser.get<std::size_t>("threads")};
+
+  picojson::array runs;
+  for (auto& corpus : corpora()) {
+    if (only != "all" && only != corpus.name) {
+      continue;
+    }
+    for (std::size_t size : sizes) {
+      std::cerr << corpus.name << " x " << size << std::endl;
+      std::string text = generate(corpus, size);
+      LineStore lines;
+
+      picojson::object run{{"corpus", picojson::value(corpus.name)}, {"lines", number(size)},
+                           {"bytes", number(text.size())}};
+      run["read_lines"] = bench_read_lines(text, lines);
+
+      picojson::object filters;
+      std::vector<Choice> fuzzy;
+      for (int m = 0; m < num_filter_modes; ++m) {
+        auto mode = static_cast<FilterMode>(m);
+        std::vector<Choice> matched;
+        filters[to_string(mode)] = bench_typing(mode, corpus.query, lines, pool, matched);
+        if (mode == FilterMode::Fuzzy) {
+          fuzzy = std::move(matched);
+        }
+      }
+      run["filter"] = picojson::value(filters);
+      run["ranking"] = bench_ranking(fuzzy);
+      run["utf8"] = bench_utf8(lines);
+      runs.push_back(picojson::value(run));
+    }
+  }
+
+  picojson::object result{{"threads", number(pool.size())},
+                          {"runs", picojson::value(runs)},
+                          {"channel", bench_channel(4000000)}};
+  std::string json = picojson::value(result).serialize(true);
+
+  auto const& output = parser.get<std::string>("output");
+  if (output.empty()) {
+    std::cout << json;
+  }
+  else {
+    std::ofstream{output} << json;
+  }
+}
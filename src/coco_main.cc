@@ -1,45 +1,56 @@
 #include "coco.hh"
+#include <fstream>
 #include <locale>
 #include <iostream>
-#include <regex>
-#include <fstream>
-
-void read_lines(std::vector<std::string>& lines, std::istream& is, std::size_t max_len)
-{
-  static std::regex ansi(R"(\x1B\[([0-9]{1,2}(;[0-9]{1,2})?)?[m|K])");
-  for (std::string line; std::getline(is, line);) {
-    if (lines.size() == max_len)
-      return;
-    lines.push_back(std::regex_replace(line, ansi, ""));
-  }
-}
-
-arc<std::vector<std::string>> get_candidates(std::string const& file, std::size_t max_buffer)
-{
-  std::vector<std::string> lines;
-  lines.reserve(max_buffer);
-
-  if (!file.empty()) {
-    std::ifstream ifs{file};
-    read_lines(lines, ifs, max_buffer);
-  }
-  else {
-    read_lines(lines, std::cin, max_buffer);
-  }
-  return lines;
-}
+#include "batch.hh"
+#include "ingest.hh"
 
 int main(int argc, char const* argv[])
 {
   std::setlocale(LC_ALL, "");
+  std::ios::sync_with_stdio(false);
 
   try {
     // Initialize Coco application.
     Config config;
     config.parse_args(argc, argv);
 
-    auto lines = get_candidates(config.file, config.max_buffer);
-    Choices choices(lines, receiver<bool>{}, config.score_min);
+    // a file which cannot be indexed is read as usual.
+    std::shared_ptr<TrigramIndex const> index;
+    if (config.use_index && !config.file.empty()) {
+      try {
+        index = TrigramIndex::load(config.file);
+      }
+      catch (std::exception& e) {
+        std::cerr << "coco: the index is not used: " << e.what() << std::endl;
+      }
+    }
+
+    if (config.batch) {
+      BatchOptions options;
+      options.score_min = config.score_min;
+      options.max_lines = config.max_buffer;
+      options.limit = config.limit;
+      options.sorted = config.sorted;
+      options.num_threads = config.num_threads;
+      auto written = index ? filter_batch(*index, std::cout, config.filter_mode, config.query, options)
+                           : filter_batch(config.file, std::cout, config.filter_mode, config.query, options);
+      std::cout.flush();
+      // as grep does, nothing matched is a failure.
+      return written > 0 ? 0 : 1;
+    }
+
+    // start reading candidates in background.
+    auto lines = std::make_shared<LineStore>();
+    sender<bool> tx;
+    receiver<bool> rx;
+    // the channel wakes up the event loop on every batch of lines.
+    std::tie(tx, rx) = make_channel<bool>(std::make_shared<Notifier>());
+    // the reader is left running when a selection is made before the input is exhausted.
+    spawn_reader(config.file, config.max_buffer, lines, std::move(tx), index).detach();
+
+    Choices choices(lines, std::move(rx), config.score_min, config.num_threads, config.folded_copy, index,
+                    config.index_memory, config.cache_memory);
 
     Coco coco{config, std::move(choices)};
 
@@ -48,7 +59,18 @@ int main(int argc, char const* argv[])
 
     // show selected line.
     for (auto&& line : selected_lines)
-      std::cout << line << std::endl;
+      std::cout << line << '\n';
+    std::cout.flush();
+
+    if (config.stats) {
+      if (config.stats_file.empty()) {
+        coco.report_stats(std::cerr);
+      }
+      else {
+        std::ofstream ofs{config.stats_file};
+        coco.report_stats(ofs);
+      }
+    }
 
     return 0;
   }
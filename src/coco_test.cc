@@ -0,0 +1,30 @@
+#include <gtest/gtest.h>
+
+#include "coco.hh"
+
+static Choices make_choices(std::vector<std::string> const& input)
+{
+  auto lines = std::make_shared<LineStore>();
+  for (auto& line : input) {
+    lines->push_back(line);
+  }
+  // no receiver, as all lines are given.
+  return Choices{lines, receiver<bool>{}, 0.0};
+}
+
+TEST(coco_test, toggle_selection_out_of_choices)
+{
+  auto choices = make_choices({"foo", "bar", "baz"});
+  choices.apply_filter(FilterMode::CaseSensitive, "zzz");
+  choices.wait_filter();
+  EXPECT_EQ(0, choices.size());
+  choices.toggle_selection(0);
+  EXPECT_TRUE(choices.get_selection(0).empty());
+
+  choices.apply_filter(FilterMode::CaseSensitive, "ba");
+  choices.wait_filter();
+  EXPECT_EQ(2, choices.size());
+  choices.toggle_selection(1);
+  choices.toggle_selection(5);
+  EXPECT_EQ(std::vector<std::string_view>{"baz"}, choices.get_selection(0));
+}
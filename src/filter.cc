@@ -1,26 +1,36 @@
 #include "filter.hh"
+#include "fuzzy.hh"
+#include "pattern.hh"
+#include "search.hh"
+#include "thread_pool.hh"
+#include "utf8.hh"
 
-#include <locale>
 #include <algorithm>
-#include <regex>
+#include <cmath>
 #include <utility>
 #include <limits>
+#include <list>
+#include <mutex>
 #include <sstream>
 
-std::ostream& operator<<(std::ostream& os, FilterMode mode)
+char const* to_string(FilterMode mode)
 {
   switch (mode) {
   case FilterMode::CaseSensitive:
-    return os << "CaseSensitive";
+    return "CaseSensitive";
   case FilterMode::SmartCase:
-    return os << "SmartCase";
+    return "SmartCase";
   case FilterMode::Regex:
-    return os << "Regex";
+    return "Regex";
+  case FilterMode::Fuzzy:
+    return "Fuzzy";
   default:
     throw std::logic_error(std::string(__FUNCTION__) + ": bad enum");
   }
 }
 
+std::ostream& operator<<(std::ostream& os, FilterMode mode) { return os << to_string(mode); }
+
 std::istream& operator>>(std::istream& is, FilterMode& mode)
 {
   std::string str;
@@ -35,18 +45,74 @@ std::istream& operator>>(std::istream& is, FilterMode& mode)
   else if (str == "Regex") {
     mode = FilterMode::Regex;
   }
+  else if (str == "Fuzzy") {
+    mode = FilterMode::Fuzzy;
+  }
   else {
     throw std::logic_error(std::string(__FUNCTION__) + ": bad option");
   }
   return is;
 }
 
-void Filter::scoring(std::vector<Choice>& choices, std::vector<std::string> const& lines)
+std::size_t Filter::scoring(std::vector<Choice>& choices, LineStore const& lines, double score_min)
+{
+  return scoring(choices.begin(), choices.end(), lines, score_min);
+}
+
+std::size_t Filter::scoring(std::vector<Choice>::iterator first, std::vector<Choice>::iterator last,
+                            LineStore const& lines, double score_min)
+{
+  for (auto it = first; it != last; ++it) {
+    it->score = static_cast<float>(score(lines[it->index]));
+  }
+  // compared in the precision scores are kept in.
+  float const min = uses_score_min() ? static_cast<float>(score_min) : 0.0f;
+  return std::stable_partition(first, last, [=](auto& choice) { return choice.score > min; }) - first;
+}
+
+// inputs smaller than this are not worth to dispatch to worker threads.
+constexpr std::size_t min_chunk_size = 4096;
+
+std::size_t Filter::scoring(std::vector<Choice>::iterator first, std::vector<Choice>::iterator last,
+                            LineStore const& lines, ThreadPool& pool, double score_min)
 {
-  for (auto& choice : choices) {
-    choice.score = query.empty() ? 1.0 : (*this)(lines[choice.index]);
+  std::size_t const n = last - first;
+  std::size_t const num_chunks = std::min(pool.size(), n / min_chunk_size);
+  if (num_chunks <= 1) {
+    return scoring(first, last, lines, score_min);
+  }
+
+  // score and partition each contiguous chunk independently.
+  std::vector<std::size_t> bounds(num_chunks + 1), matched(num_chunks);
+  for (std::size_t i = 0; i <= num_chunks; ++i) {
+    bounds[i] = n * i / num_chunks;
+  }
+  pool.run(num_chunks, [&](std::size_t i) {
+    matched[i] = scoring(first + bounds[i], first + bounds[i + 1], lines, score_min);
+  });
+
+  // gather the matched part of each chunk at the front and the rest at the back,
+  // both in the original order.
+  std::vector<std::size_t> head(num_chunks + 1), tail(num_chunks + 1);
+  for (std::size_t i = 0; i < num_chunks; ++i) {
+    head[i + 1] = head[i] + matched[i];
   }
-  std::stable_sort(choices.begin(), choices.end(), std::greater<Choice>{});
+  tail[0] = head[num_chunks];
+  for (std::size_t i = 0; i < num_chunks; ++i) {
+    tail[i + 1] = tail[i] + (bounds[i + 1] - bounds[i] - matched[i]);
+  }
+
+  std::vector<Choice> buf(n);
+  pool.run(num_chunks, [&](std::size_t i) {
+    auto begin = first + bounds[i], mid = begin + matched[i], end = first + bounds[i + 1];
+    std::copy(begin, mid, buf.begin() + head[i]);
+    std::copy(mid, end, buf.begin() + tail[i]);
+  });
+  pool.run(num_chunks, [&](std::size_t i) {
+    std::copy(buf.begin() + bounds[i], buf.begin() + bounds[i + 1], first + bounds[i]);
+  });
+
+  return head[num_chunks];
 }
 
 class CaseSensitiveFilter : public Filter {
@@ -63,10 +129,12 @@ public:
     }
   }
 
-  double operator()(std::string const& line) const override
+  std::vector<std::string> required_substrings() const override { return words; }
+
+  double operator()(std::string_view line) const override
   {
     for (auto& word : words) {
-      if (line.find(word) == std::string::npos) {
+      if (!contains(line, word)) {
         return false;
       }
     }
@@ -74,26 +142,68 @@ public:
   }
 };
 
+// matches case-insensitively, unless the query has an uppercase character.
 class SmartCaseFilter : public Filter {
-  std::vector<std::string> words;
-  std::locale l;
+  struct Word {
+    std::string text; // lower-cased unless `case_sensitive`
+    bool ascii;
+  };
+  std::vector<Word> words;
+  bool case_sensitive;
+  bool folded_lines = false;
 
 public:
-  SmartCaseFilter(std::string const& query) : Filter{query}, l{std::locale::classic()}
+  SmartCaseFilter(std::string const& query) : Filter{query}, case_sensitive{has_upper_utf8(query)}
   {
     std::istringstream iss(query);
     for (std::string word; std::getline(iss, word, ' ');) {
-      if (word.find(" ") == std::string::npos) {
-        words.push_back(word);
+      bool ascii = std::all_of(word.begin(), word.end(), [](char c) { return (c & 0x80) == 0; });
+      if (!case_sensitive) {
+        std::string folded;
+        fold_case_utf8(word, folded);
+        word = std::move(folded);
+      }
+      words.push_back(Word{std::move(word), ascii});
+    }
+  }
+
+  bool use_folded_lines() override { return folded_lines = !case_sensitive; }
+
+  // non-ASCII words are left out when matched case-insensitively, since folding may change their bytes.
+  std::vector<std::string> required_substrings() const override
+  {
+    std::vector<std::string> result;
+    for (auto& word : words) {
+      if (case_sensitive || word.ascii) {
+        result.push_back(word.text);
       }
     }
+    return result;
   }
 
-  double operator()(std::string const& line) const override
+  double operator()(std::string_view line) const override
   {
-    auto pred = [&](auto c1, auto c2) { return std::toupper(c1, l) == std::toupper(c2, l); };
+    if (case_sensitive) {
+      return std::all_of(words.begin(), words.end(), [&](auto& word) { return contains(line, word.text); });
+    }
+
+    // lines are folded in full only for words with non-ASCII characters.
+    thread_local std::string folded;
+    bool is_folded = false;
     for (auto& word : words) {
-      if (std::search(line.begin(), line.end(), word.begin(), word.end(), pred) == line.end()) {
+      bool found;
+      if (word.ascii) {
+        found = folded_lines ? contains(line, word.text) : contains_icase(line, word.text);
+      }
+      else {
+        if (!is_folded) {
+          folded.clear();
+          fold_case_utf8(line, folded);
+          is_folded = true;
+        }
+        found = contains(folded, word.text);
+      }
+      if (!found) {
         return false;
       }
     }
@@ -101,13 +211,92 @@ public:
   }
 };
 
+// compiled patterns are reused, since the same queries come back on backspaces and mode rotations.
+constexpr std::size_t pattern_cache_size = 16;
+
+static std::shared_ptr<Pattern const> compile_pattern(std::string const& source)
+{
+  static std::mutex mutex;
+  static std::list<std::pair<std::string, std::shared_ptr<Pattern const>>> cache;
+
+  std::lock_guard<std::mutex> lock{mutex};
+  auto found = std::find_if(cache.begin(), cache.end(), [&](auto& entry) { return entry.first == source; });
+  if (found != cache.end()) {
+    cache.splice(cache.begin(), cache, found);
+    return cache.front().second;
+  }
+
+  auto pattern = std::make_shared<Pattern const>(source);
+  cache.emplace_front(source, pattern);
+  if (cache.size() > pattern_cache_size) {
+    cache.pop_back();
+  }
+  return pattern;
+}
+
 class RegexFilter : public Filter {
-  std::regex re;
+  std::shared_ptr<Pattern const> pattern;
+
+public:
+  RegexFilter(std::string const& query) : Filter{query}, pattern{compile_pattern(query)} {}
+
+  double operator()(std::string_view line) const override { return pattern->search(line) ? 1.0 : 0.0; }
+
+  std::vector<std::string> required_substrings() const override
+  {
+    if (pattern->required_literal().empty()) {
+      return {};
+    }
+    return {pattern->required_literal()};
+  }
+};
+
+class FuzzyFilter : public Filter {
+  struct Word {
+    std::string text;
+    bool case_sensitive;
+  };
+  std::vector<Word> words;
+  std::size_t length = 0;
 
 public:
-  RegexFilter(std::string const& query) : Filter{query}, re{query} {}
+  FuzzyFilter(std::string const& query) : Filter{query}
+  {
+    std::istringstream iss(query);
+    for (std::string word; std::getline(iss, word, ' ');) {
+      if (!word.empty()) {
+        // smart case: a word with an uppercase letter is matched exactly.
+        bool upper = std::any_of(word.begin(), word.end(), [](char c) { return 'A' <= c && c <= 'Z'; });
+        length += word.size();
+        words.push_back(Word{std::move(word), upper});
+      }
+    }
+  }
+
+  bool is_ranked() const override { return true; }
+  // every subsequence match is shown, however scattered or far into the line.
+  bool uses_score_min() const override { return false; }
+
+  double operator()(std::string_view line) const override
+  {
+    if (words.empty()) {
+      return 1.0;
+    }
+
+    double total = 0.0;
+    for (auto& word : words) {
+      double score;
+      if (!fuzzy_match(word.text, line, word.case_sensitive, score)) {
+        return 0.0;
+      }
+      total += score;
+    }
 
-  double operator()(std::string const& line) const override { return std::regex_search(line, re) ? 1.0 : 0.0; }
+    // map the average score per query byte into (0, 1). a match far into a long line scores so low that
+    // the sigmoid would round to 0, so it is kept above 0 in the precision of Choice::score.
+    double const score = 1.0 / (1.0 + std::exp(-total / length));
+    return std::max<double>(score, std::numeric_limits<float>::min());
+  }
 };
 
 std::unique_ptr<Filter> score_by(FilterMode mode, std::string const& query)
@@ -119,7 +308,24 @@ std::unique_ptr<Filter> score_by(FilterMode mode, std::string const& query)
     return std::make_unique<SmartCaseFilter>(query);
   case FilterMode::Regex:
     return std::make_unique<RegexFilter>(query);
+  case FilterMode::Fuzzy:
+    return std::make_unique<FuzzyFilter>(query);
   default:
     throw std::runtime_error(std::string(__FUNCTION__) + ": invalid mode");
   }
 }
+
+bool is_narrowing(FilterMode mode, std::string const& prev, std::string const& query)
+{
+  switch (mode) {
+  case FilterMode::CaseSensitive:
+  case FilterMode::SmartCase:
+  case FilterMode::Fuzzy:
+    // appending characters either extends the last word or adds a new word,
+    // and both can only reduce the set of matched lines.
+    // Fuzzy keeps every subsequence match regardless of `score_min`, so that this holds for it as well.
+    return query.size() >= prev.size() && query.compare(0, prev.size(), prev) == 0;
+  default:
+    return false;
+  }
+}
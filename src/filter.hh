@@ -4,15 +4,23 @@
 #include <iosfwd>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <memory>
 #include "choice.hh"
+#include "line_store.hh"
+
+class ThreadPool;
 
 enum FilterMode {
   CaseSensitive = 0,
   SmartCase = 1,
   Regex = 2,
+  Fuzzy = 3,
 };
 
+constexpr int num_filter_modes = 4;
+
+char const* to_string(FilterMode mode);
 std::ostream& operator<<(std::ostream& os, FilterMode mode);
 std::istream& operator>>(std::istream& is, FilterMode& mode);
 
@@ -23,10 +31,37 @@ public:
   Filter(std::string const& query) : query{query} {}
 
   virtual ~Filter() = default;
-  virtual double operator()(std::string const& line) const = 0;
-  void scoring(std::vector<Choice>& choices, std::vector<std::string> const& lines);
+  virtual double operator()(std::string_view line) const = 0;
+
+  // whether scores take more values than 0 and 1, i.e. matched lines need to be sorted by score.
+  virtual bool is_ranked() const { return false; }
+
+  // asks the filter to take lines lower-cased by fold_ascii() instead of the original ones.
+  // returns false if the result would change, e.g. when matching case-sensitively.
+  virtual bool use_folded_lines() { return false; }
+
+  // whether lines scored at or below `score_min` are dropped. if not, every line scored above 0 is matched.
+  virtual bool uses_score_min() const { return true; }
+
+  // strings which every matched line contains, ignoring the case of ASCII letters, to look up an index with.
+  virtual std::vector<std::string> required_substrings() const { return {}; }
+
+  // scores lines and moves the ones scored above `score_min` to the front, keeping their relative order.
+  // returns the number of such lines. ranking them is left to the caller.
+  std::size_t scoring(std::vector<Choice>& choices, LineStore const& lines, double score_min = 0.0);
+  std::size_t scoring(std::vector<Choice>::iterator first, std::vector<Choice>::iterator last,
+                      LineStore const& lines, double score_min = 0.0);
+  std::size_t scoring(std::vector<Choice>::iterator first, std::vector<Choice>::iterator last,
+                      LineStore const& lines, ThreadPool& pool, double score_min = 0.0);
+
+private:
+  double score(std::string_view line) const { return query.empty() ? 1.0 : (*this)(line); }
 };
 
 std::unique_ptr<Filter> score_by(FilterMode mode, std::string const& query);
 
+// returns true if every line matched by `query` is also matched by `prev` under `mode`,
+// so that the result of `query` can be computed from the survivors of `prev` alone.
+bool is_narrowing(FilterMode mode, std::string const& prev, std::string const& query);
+
 #endif
\ No newline at end of file
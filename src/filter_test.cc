@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
+#include <algorithm>
 #include "filter.hh"
+#include "search.hh"
+#include "thread_pool.hh"
 
 TEST(filter_test, score_by_regex1)
 {
@@ -18,3 +21,142 @@ TEST(filter_test, score_by_regex2)
   EXPECT_EQ(1.0, (*score)(u8"ほげほげ"));
   EXPECT_EQ(0.0, (*score)(u8"🍣🐟💰"));
 }
+
+TEST(filter_test, is_narrowing)
+{
+  EXPECT_TRUE(is_narrowing(FilterMode::CaseSensitive, "foo", "foob"));
+  EXPECT_TRUE(is_narrowing(FilterMode::SmartCase, "foo", "foo bar"));
+  EXPECT_TRUE(is_narrowing(FilterMode::SmartCase, "", "f"));
+
+  EXPECT_FALSE(is_narrowing(FilterMode::CaseSensitive, "foo", "fo"));
+  EXPECT_FALSE(is_narrowing(FilterMode::CaseSensitive, "foo", "bar foo"));
+  EXPECT_FALSE(is_narrowing(FilterMode::Regex, "fo", "foo"));
+}
+
+TEST(filter_test, scoring_partitions_matches)
+{
+  LineStore lines;
+  for (auto line : {"foo", "bar", "foobar", "baz", "barfoo"}) {
+    lines.push_back(line);
+  }
+  std::vector<Choice> choices;
+  for (std::size_t i = 0; i < lines.size(); ++i) {
+    choices.emplace_back(i);
+  }
+
+  auto score = score_by(FilterMode::CaseSensitive, "foo");
+  ASSERT_EQ(3, score->scoring(choices, lines));
+  EXPECT_EQ(0, choices[0].index);
+  EXPECT_EQ(2, choices[1].index);
+  EXPECT_EQ(4, choices[2].index);
+}
+
+TEST(filter_test, parallel_scoring)
+{
+  LineStore lines;
+  for (int i = 0; i < 100000; ++i) {
+    lines.push_back(std::to_string(i * 7919 % 100003));
+  }
+  std::vector<Choice> expected, actual;
+  for (std::size_t i = 0; i < lines.size(); ++i) {
+    expected.emplace_back(i);
+    actual.emplace_back(i);
+  }
+
+  ThreadPool pool{4};
+  auto score = score_by(FilterMode::CaseSensitive, "12");
+  EXPECT_EQ(score->scoring(expected, lines), score->scoring(actual.begin(), actual.end(), lines, pool));
+
+  ASSERT_EQ(expected.size(), actual.size());
+  for (std::size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i].index, actual[i].index);
+    EXPECT_EQ(expected[i].score, actual[i].score);
+  }
+}
+
+TEST(filter_test, score_by_fuzzy)
+{
+  auto score = score_by(FilterMode::Fuzzy, "fb");
+
+  EXPECT_LT(0.0, (*score)("foobar"));
+  EXPECT_LT(0.0, (*score)("FooBar"));
+  EXPECT_EQ(0.0, (*score)("barfoo"));
+
+  // word boundaries and consecutive matches rank higher than scattered ones.
+  EXPECT_GT((*score)("foo/bar"), (*score)("afoobar"));
+  EXPECT_GT((*score)("fbxxxx"), (*score)("fxxxxb"));
+  EXPECT_GT((*score)("FooBar"), (*score)("Foobar"));
+}
+
+TEST(filter_test, score_by_fuzzy_far_match)
+{
+  LineStore lines;
+  lines.push_back(std::string(2000, 'x') + "foo" + std::string(2000, 'x') + "bar");
+  lines.push_back(std::string(100000, 'x') + "fb");
+  lines.push_back("foobar");
+  lines.push_back("nothing");
+
+  // every subsequence match is kept, even if it scores lower than `score_min`.
+  std::vector<Choice> choices{0, 1, 2, 3};
+  EXPECT_EQ(3, score_by(FilterMode::Fuzzy, "fb")->scoring(choices, lines, 0.01));
+  EXPECT_EQ(2, score_by(FilterMode::Fuzzy, "foo bar")->scoring(choices, lines, 0.01));
+  EXPECT_EQ(0, choices[0].index);
+  EXPECT_EQ(2, choices[1].index);
+  EXPECT_LT(choices[0].score, choices[1].score);
+}
+
+TEST(filter_test, score_by_fuzzy_smart_case)
+{
+  auto score = score_by(FilterMode::Fuzzy, "FB");
+  EXPECT_LT(0.0, (*score)("FooBar"));
+  EXPECT_EQ(0.0, (*score)("foobar"));
+}
+
+TEST(filter_test, score_by_fuzzy_multibyte)
+{
+  auto score = score_by(FilterMode::Fuzzy, u8"ほげ");
+
+  EXPECT_LT(0.0, (*score)(u8"ほ/げ"));
+  // the bytes of a character must not be matched apart.
+  EXPECT_EQ(0.0, (*score)(u8"ぼǻげ"));
+}
+
+TEST(filter_test, score_by_smart_case)
+{
+  auto lower = score_by(FilterMode::SmartCase, "foo bar");
+  EXPECT_EQ(1.0, (*lower)("FooBar"));
+  EXPECT_EQ(1.0, (*lower)("a bar, a FOO"));
+  EXPECT_EQ(0.0, (*lower)("Foo"));
+
+  // a query with an uppercase letter is matched exactly.
+  auto upper = score_by(FilterMode::SmartCase, "Foo bar");
+  EXPECT_EQ(1.0, (*upper)("Foobar"));
+  EXPECT_EQ(0.0, (*upper)("FooBar"));
+  EXPECT_EQ(0.0, (*upper)("foobar"));
+}
+
+TEST(filter_test, smart_case_folded_lines)
+{
+  LineStore lines, folded;
+  for (auto line : {"FooBar", "foo", "BAR", "x"}) {
+    std::string lower = line;
+    std::transform(lower.begin(), lower.end(), lower.begin(), fold_ascii);
+    lines.push_back(line);
+    folded.push_back(lower);
+  }
+  std::vector<Choice> expected, actual;
+  for (std::size_t i = 0; i < lines.size(); ++i) {
+    expected.emplace_back(i);
+    actual.emplace_back(i);
+  }
+
+  auto score = score_by(FilterMode::SmartCase, "bar");
+  ASSERT_TRUE(score->use_folded_lines());
+  EXPECT_EQ(2, score->scoring(actual, folded));
+  EXPECT_EQ(2, score_by(FilterMode::SmartCase, "bar")->scoring(expected, lines));
+  for (std::size_t i = 0; i < lines.size(); ++i) {
+    EXPECT_EQ(expected[i].index, actual[i].index);
+  }
+
+  EXPECT_FALSE(score_by(FilterMode::SmartCase, "Bar")->use_folded_lines());
+}
@@ -0,0 +1,269 @@
+#include "filter_worker.hh"
+#include "ngram_index.hh"
+#include "search.hh"
+
+#include <algorithm>
+#include <regex>
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// the first block is small so that the first screenful is sent quickly, and later ones grow up to the limit.
+constexpr std::size_t first_block_size = 16384;
+constexpr std::size_t max_block_size = 262144;
+
+FilterWorker::FilterWorker(std::shared_ptr<LineStore> lines, sender<FilterUpdate> tx, double score_min, std::size_t num_threads,
+                           bool use_folded, std::shared_ptr<LineIndex const> index, std::size_t cache_memory)
+    : lines(lines), index(std::move(index)), tx(std::move(tx)), pool(num_threads), score_min(score_min),
+      cache(cache_memory), use_folded(use_folded)
+{
+  thread = std::thread([this] { worker_main(); });
+}
+
+FilterWorker::~FilterWorker()
+{
+  if (indexer.joinable()) {
+    indexer_stopped = true;
+    indexer.join();
+  }
+  {
+    std::lock_guard<std::mutex> lock{m};
+    stopped = true;
+    // also cancels the running job.
+    ++requested;
+  }
+  cv.notify_one();
+  thread.join();
+}
+
+std::size_t FilterWorker::request(FilterMode mode, std::string const& query)
+{
+  std::size_t generation;
+  {
+    std::lock_guard<std::mutex> lock{m};
+    request_mode = mode;
+    request_query = query;
+    generation = ++requested;
+  }
+  cv.notify_one();
+  return generation;
+}
+
+void FilterWorker::notify_lines()
+{
+  {
+    std::lock_guard<std::mutex> lock{m};
+    lines_pending = true;
+  }
+  cv.notify_one();
+}
+
+void FilterWorker::start_indexing(std::size_t memory_limit)
+{
+  if (std::atomic_load(&index) || indexer.joinable()) {
+    return;
+  }
+  building = true;
+  indexer = std::thread([this, memory_limit, snapshot = lines->snapshot()] {
+#ifdef __linux__
+    // the lowest priority, so that the event loop and filtering are not slowed down by it.
+    ::setpriority(PRIO_PROCESS, static_cast<id_t>(::syscall(SYS_gettid)), 19);
+#endif
+    auto built = NgramIndex::build(snapshot, memory_limit, indexer_stopped);
+    if (built) {
+      std::atomic_store(&index, std::shared_ptr<LineIndex const>(std::move(built)));
+    }
+    building = false;
+    // wakes up the receiver, which ignores updates of no generation.
+    tx.send(FilterUpdate{});
+  });
+}
+
+std::size_t FilterWorker::indexed_lines() const
+{
+  auto index = std::atomic_load(&this->index);
+  return index ? index->num_lines() : 0;
+}
+
+void FilterWorker::worker_main()
+{
+  std::size_t started = 0;
+  while (true) {
+    std::size_t generation = 0;
+    FilterMode mode;
+    std::string query;
+    {
+      std::unique_lock<std::mutex> lock{m};
+      cv.wait(lock, [&] { return stopped || requested.load() != started || lines_pending; });
+      if (stopped) {
+        return;
+      }
+      // a job also takes the lines appended so far.
+      lines_pending = false;
+      if (requested.load() != started) {
+        generation = started = requested.load();
+        mode = request_mode;
+        query = request_query;
+      }
+    }
+
+    if (generation != 0) {
+      run_job(generation, mode, query);
+    }
+    else {
+      extend();
+    }
+  }
+}
+
+void FilterWorker::run_job(std::size_t generation, FilterMode mode, std::string const& query)
+{
+  // a query filtered before only needs the lines appended since then.
+  if (cache.get(mode, query, base, covered, last_ranked)) {
+    filtered = true;
+    last_generation = generation;
+    last_mode = mode;
+    last_query = query;
+    tx.send(FilterUpdate{generation, true, covered == lines->size(), last_ranked, base});
+    extend();
+    return;
+  }
+
+  std::unique_ptr<Filter> scorer;
+  try {
+    scorer = score_by(mode, query);
+  }
+  catch (std::regex_error&) {
+    // the last result stays, and lines appended from now on are added to it.
+    last_generation = generation;
+    tx.send(FilterUpdate{generation, true, true, last_ranked, base});
+    return;
+  }
+
+  // if the query only grows, lines which have been dropped can never match again.
+  // then the candidates are the last result followed by the lines it has not covered.
+  bool narrowing = filtered && mode == last_mode && is_narrowing(mode, last_query, query);
+  std::size_t const num_lines = lines->size();
+  std::size_t const num_prev = narrowing ? base.size() : 0;
+  std::size_t const from = narrowing ? covered : 0;
+  std::vector<std::uint32_t> found;
+  bool const indexed = lookup(*scorer, from, num_lines, found);
+  std::size_t const count = num_prev + (indexed ? found.size() : num_lines - from);
+
+  std::vector<Choice> result, block;
+  std::size_t pos = 0;
+  std::size_t block_size = first_block_size;
+  do {
+    if (cancelled(generation)) {
+      return;
+    }
+    block.resize(std::min(block_size, count - pos));
+    for (std::size_t i = 0; i < block.size(); ++i) {
+      std::size_t k = pos + i - num_prev;
+      block[i] = pos + i < num_prev ? base[pos + i] : Choice(indexed ? found[k] : from + k);
+    }
+
+    Stopwatch watch;
+    std::size_t matched = scorer->scoring(block.begin(), block.end(), source_for(*scorer), pool, score_min);
+    double seconds = watch.elapsed();
+    result.insert(result.end(), block.begin(), block.begin() + matched);
+
+    bool first = pos == 0;
+    pos += block.size();
+    block.resize(matched);
+    tx.send(FilterUpdate{generation, first, pos == count, scorer->is_ranked(), block, seconds});
+
+    block_size = std::min(block_size * 2, max_block_size);
+  } while (pos < count);
+
+  base = std::move(result);
+  covered = num_lines;
+  filtered = true;
+  last_generation = generation;
+  last_mode = mode;
+  last_query = query;
+  last_ranked = scorer->is_ranked();
+  cache.put(mode, query, base, covered, last_ranked);
+}
+
+void FilterWorker::extend()
+{
+  std::size_t const num_lines = lines->size();
+  if (!filtered || covered >= num_lines) {
+    return;
+  }
+  auto scorer = score_by(last_mode, last_query);
+
+  std::vector<Choice> block;
+  std::vector<std::uint32_t> found;
+  while (covered < num_lines) {
+    // a pending job takes the rest.
+    if (cancelled(last_generation)) {
+      return;
+    }
+    std::size_t const end = std::min(covered + max_block_size, num_lines);
+    if (lookup(*scorer, covered, end, found)) {
+      block.assign(found.begin(), found.end());
+    }
+    else {
+      block.resize(end - covered);
+      for (std::size_t i = 0; i < block.size(); ++i) {
+        block[i] = Choice(covered + i);
+      }
+    }
+
+    Stopwatch watch;
+    std::size_t matched = scorer->scoring(block.begin(), block.end(), source_for(*scorer), pool, score_min);
+    double seconds = watch.elapsed();
+    base.insert(base.end(), block.begin(), block.begin() + matched);
+    covered = end;
+    block.resize(matched);
+    tx.send(FilterUpdate{last_generation, false, true, scorer->is_ranked(), block, seconds});
+  }
+  cache.put(last_mode, last_query, base, covered, last_ranked);
+}
+
+// returns the lines to be given to `scorer`, which are the lower-cased copy if it is enabled and accepted.
+LineStore const& FilterWorker::source_for(Filter& scorer)
+{
+  LineStore const& all = *lines;
+  if (!use_folded || !scorer.use_folded_lines()) {
+    return all;
+  }
+
+  // lines without uppercase letters are shared with the original store.
+  std::string buf;
+  for (std::size_t i = folded.size(), n = all.size(); i < n; ++i) {
+    auto line = all[i];
+    auto upper = std::find_if(line.begin(), line.end(), [](char c) { return 'A' <= c && c <= 'Z'; });
+    if (upper == line.end()) {
+      folded.push_back_borrowed(line);
+      continue;
+    }
+    buf.assign(line.begin(), line.end());
+    auto from = buf.begin() + (upper - line.begin());
+    std::transform(from, buf.end(), from, fold_ascii);
+    folded.push_back(buf);
+  }
+  return folded;
+}
+
+// puts the lines in [first, last) which may match `scorer` into `out`, if the index can tell them.
+bool FilterWorker::lookup(Filter const& scorer, std::size_t first, std::size_t last, std::vector<std::uint32_t>& out) const
+{
+  auto index = std::atomic_load(&this->index);
+  if (!index) {
+    return false;
+  }
+  // lines the index does not know of are all candidates.
+  std::size_t const known = std::min(last, index->num_lines());
+  if (first >= known || !index->lookup(scorer.required_substrings(), first, known, out)) {
+    return false;
+  }
+  for (std::size_t i = known; i < last; ++i) {
+    out.push_back(static_cast<std::uint32_t>(i));
+  }
+  return true;
+}
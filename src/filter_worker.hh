@@ -0,0 +1,103 @@
+#ifndef __HEADER_FILTER_WORKER__
+#define __HEADER_FILTER_WORKER__
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "channel.hh"
+#include "choice.hh"
+#include "filter.hh"
+#include "line_store.hh"
+#include "result_cache.hh"
+#include "stats.hh"
+#include "thread_pool.hh"
+#include "line_index.hh"
+
+// a piece of the result of a filtering job.
+struct FilterUpdate {
+  std::size_t generation = 0;
+  bool reset = false; // `choices` replace the ones received so far, rather than follow them.
+  bool done = false;  // no more updates follow for this generation, unless lines are appended.
+  bool ranked = false;
+  std::vector<Choice> choices;
+  double seconds = 0; // time spent scoring the lines of this update.
+};
+
+// runs filters on a background thread.
+//
+// every request gets a new generation, and cancels the running job at the next block of lines.
+// matched choices are sent to `tx` block by block in input order, so the first screenful shows up
+// before the whole input is scanned. ranking them is left to the receiver.
+// lines appended after a job has finished are scored against its query and sent as further updates.
+// given an index of the lines, only the lines it finds for the query are scored.
+// without one, an index may be built in memory on another thread, and it is used once it is ready.
+class FilterWorker {
+  std::shared_ptr<LineStore> lines;
+  // accessed with std::atomic_load and std::atomic_store, as the indexer sets it while jobs run.
+  std::shared_ptr<LineIndex const> index;
+  sender<FilterUpdate> tx;
+  ThreadPool pool;
+  double score_min;
+
+  // requests from other threads.
+  std::mutex m;
+  std::condition_variable cv;
+  std::atomic<std::size_t> requested{0};
+  FilterMode request_mode;
+  std::string request_query;
+  bool lines_pending = false;
+  bool stopped = false;
+
+  // the lines matched by the last finished job in input order, which are the first `covered` lines filtered.
+  std::vector<Choice> base;
+  std::size_t covered = 0;
+  bool filtered = false;
+  std::size_t last_generation = 0;
+  FilterMode last_mode;
+  std::string last_query;
+  bool last_ranked = false;
+  // the results of recent queries, which `base` and `covered` are restored from.
+  ResultCache cache;
+
+  // lines lower-cased by fold_ascii(), built on demand for filters which accept them.
+  bool use_folded;
+  LineStore folded;
+
+  std::thread thread;
+  std::thread indexer;
+  std::atomic<bool> indexer_stopped{false};
+  std::atomic<bool> building{false};
+
+public:
+  FilterWorker(std::shared_ptr<LineStore> lines, sender<FilterUpdate> tx, double score_min, std::size_t num_threads = 1,
+               bool use_folded = false, std::shared_ptr<LineIndex const> index = nullptr, std::size_t cache_memory = 0);
+  FilterWorker(FilterWorker const&) = delete;
+  FilterWorker& operator=(FilterWorker const&) = delete;
+  ~FilterWorker();
+
+  // starts filtering all lines with `query`, and returns the generation of its updates.
+  std::size_t request(FilterMode mode, std::string const& query);
+  // tells that lines have been appended to the store.
+  void notify_lines();
+
+  // starts indexing the lines appended so far on a low-priority thread, using at most `memory_limit` bytes.
+  // does nothing if there is an index already. an empty update is sent when the index gets ready.
+  void start_indexing(std::size_t memory_limit);
+  bool indexing() const noexcept { return building.load(); }
+  // the number of lines the index covers, or 0 if there is no index.
+  std::size_t indexed_lines() const;
+
+private:
+  void worker_main();
+  void run_job(std::size_t generation, FilterMode mode, std::string const& query);
+  void extend();
+  bool cancelled(std::size_t generation) const { return requested.load() != generation; }
+  LineStore const& source_for(Filter& scorer);
+  bool lookup(Filter const& scorer, std::size_t first, std::size_t last, std::vector<std::uint32_t>& out) const;
+};
+
+#endif
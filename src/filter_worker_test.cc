@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include "filter_worker.hh"
+
+// collects the updates of `generation` until it is done.
+static std::vector<std::size_t> receive_all(receiver<FilterUpdate>& rx, std::size_t generation)
+{
+  std::vector<std::size_t> indices;
+  while (true) {
+    auto update = rx.recv();
+    if (update.generation != generation) {
+      continue;
+    }
+    if (update.reset) {
+      indices.clear();
+    }
+    for (auto& choice : update.choices) {
+      indices.push_back(choice.index);
+    }
+    if (update.done) {
+      return indices;
+    }
+  }
+}
+
+static std::vector<std::size_t> expected(LineStore const& lines, std::string const& word)
+{
+  std::vector<std::size_t> indices;
+  for (std::size_t i = 0; i < lines.size(); ++i) {
+    if (lines[i].find(word) != std::string_view::npos) {
+      indices.push_back(i);
+    }
+  }
+  return indices;
+}
+
+TEST(filter_worker_test, filters_in_blocks)
+{
+  auto lines = std::make_shared<LineStore>();
+  for (int i = 0; i < 100000; ++i) {
+    lines->push_back(std::to_string(i));
+  }
+  sender<FilterUpdate> tx;
+  receiver<FilterUpdate> rx;
+  std::tie(tx, rx) = make_channel<FilterUpdate>();
+  FilterWorker worker{lines, std::move(tx), 0.0, 2};
+
+  auto generation = worker.request(FilterMode::CaseSensitive, "12");
+  EXPECT_EQ(expected(*lines, "12"), receive_all(rx, generation));
+
+  // narrowed from the last result.
+  generation = worker.request(FilterMode::CaseSensitive, "123");
+  EXPECT_EQ(expected(*lines, "123"), receive_all(rx, generation));
+}
+
+TEST(filter_worker_test, newer_request_wins)
+{
+  auto lines = std::make_shared<LineStore>();
+  for (int i = 0; i < 500000; ++i) {
+    lines->push_back(std::to_string(i * 7));
+  }
+  sender<FilterUpdate> tx;
+  receiver<FilterUpdate> rx;
+  std::tie(tx, rx) = make_channel<FilterUpdate>();
+  FilterWorker worker{lines, std::move(tx), 0.0, 2};
+
+  worker.request(FilterMode::CaseSensitive, "1");
+  worker.request(FilterMode::CaseSensitive, "12");
+  auto generation = worker.request(FilterMode::CaseSensitive, "3");
+  EXPECT_EQ(expected(*lines, "3"), receive_all(rx, generation));
+}
+
+TEST(filter_worker_test, appended_lines)
+{
+  auto lines = std::make_shared<LineStore>();
+  lines->push_back("foo");
+  sender<FilterUpdate> tx;
+  receiver<FilterUpdate> rx;
+  std::tie(tx, rx) = make_channel<FilterUpdate>();
+  FilterWorker worker{lines, std::move(tx), 0.0, 1};
+
+  auto generation = worker.request(FilterMode::CaseSensitive, "o");
+  EXPECT_EQ(std::vector<std::size_t>{0}, receive_all(rx, generation));
+
+  lines->push_back("bar");
+  lines->push_back("boo");
+  worker.notify_lines();
+  EXPECT_EQ(std::vector<std::size_t>{2}, receive_all(rx, generation));
+}
+
+TEST(filter_worker_test, builds_index)
+{
+  auto lines = std::make_shared<LineStore>();
+  for (int i = 0; i < 100000; ++i) {
+    lines->push_back(std::to_string(i));
+  }
+  sender<FilterUpdate> tx;
+  receiver<FilterUpdate> rx;
+  std::tie(tx, rx) = make_channel<FilterUpdate>();
+  FilterWorker worker{lines, std::move(tx), 0.0, 2};
+  EXPECT_EQ(0, worker.indexed_lines());
+
+  worker.start_indexing(std::size_t{1} << 30);
+  // an update of no generation tells the index is ready.
+  while (rx.recv().generation != 0) {
+  }
+  EXPECT_FALSE(worker.indexing());
+  EXPECT_EQ(lines->size(), worker.indexed_lines());
+
+  // lines appended after the index is built are scanned.
+  for (int i = 100000; i < 110000; ++i) {
+    lines->push_back(std::to_string(i));
+  }
+  for (auto query : {"12", "123", "1", "09", "0912"}) {
+    auto generation = worker.request(FilterMode::CaseSensitive, query);
+    EXPECT_EQ(expected(*lines, query), receive_all(rx, generation)) << query;
+  }
+}
+
+TEST(filter_worker_test, cached_results)
+{
+  auto lines = std::make_shared<LineStore>();
+  lines->push_back("foo");
+  lines->push_back("bar");
+  sender<FilterUpdate> tx;
+  receiver<FilterUpdate> rx;
+  std::tie(tx, rx) = make_channel<FilterUpdate>();
+  FilterWorker worker{lines, std::move(tx), 0.0, 1, false, nullptr, std::size_t{1} << 20};
+
+  auto generation = worker.request(FilterMode::CaseSensitive, "o");
+  EXPECT_EQ(std::vector<std::size_t>{0}, receive_all(rx, generation));
+  generation = worker.request(FilterMode::CaseSensitive, "a");
+  EXPECT_EQ(std::vector<std::size_t>{1}, receive_all(rx, generation));
+
+  // a cached result is followed by the lines appended after it.
+  lines->push_back("boo");
+  generation = worker.request(FilterMode::CaseSensitive, "o");
+  EXPECT_EQ((std::vector<std::size_t>{0, 2}), receive_all(rx, generation));
+  generation = worker.request(FilterMode::Regex, "o$");
+  EXPECT_EQ((std::vector<std::size_t>{0, 2}), receive_all(rx, generation));
+  generation = worker.request(FilterMode::CaseSensitive, "a");
+  EXPECT_EQ(std::vector<std::size_t>{1}, receive_all(rx, generation));
+}
@@ -0,0 +1,188 @@
+#include "fuzzy.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include "utf8.hh"
+
+namespace {
+
+constexpr double score_gap_leading = -0.005;
+constexpr double score_gap_trailing = -0.005;
+constexpr double score_gap_inner = -0.01;
+constexpr double score_match_consecutive = 1.0;
+constexpr double score_match_slash = 0.9;
+constexpr double score_match_word = 0.8;
+constexpr double score_match_capital = 0.7;
+constexpr double score_match_dot = 0.6;
+constexpr double score_none = -std::numeric_limits<double>::infinity();
+
+// windows wider than this are scored by gaps only, to bound the cost of the DP.
+constexpr std::size_t max_window = 1024;
+
+inline unsigned char fold(unsigned char c) { return ('A' <= c && c <= 'Z') ? (c | 0x20) : c; }
+
+inline bool is_lower(unsigned char c) { return 'a' <= c && c <= 'z'; }
+inline bool is_upper(unsigned char c) { return 'A' <= c && c <= 'Z'; }
+
+// the bonus for a match at `j`, depending on the preceding character.
+inline double bonus_at(std::string_view s, std::size_t j)
+{
+  unsigned char prev = j > 0 ? s[j - 1] : '/';
+  if (prev == '/')
+    return score_match_slash;
+  if (prev == '-' || prev == '_' || prev == ' ')
+    return score_match_word;
+  if (prev == '.')
+    return score_match_dot;
+  if (is_lower(prev) && is_upper(s[j]))
+    return score_match_capital;
+  return 0.0;
+}
+
+struct Matcher {
+  std::string_view needle;
+  std::string_view haystack;
+  bool case_sensitive;
+
+  bool eq(std::size_t i, std::size_t j) const
+  {
+    return case_sensitive ? needle[i] == haystack[j] : fold(needle[i]) == fold(haystack[j]);
+  }
+
+  // length of the UTF-8 character in `needle` starting at `i`, which is matched as a unit.
+  std::size_t unit_length(std::size_t i) const
+  {
+    std::size_t len = 1;
+    while (i + len < needle.size() && is_utf8_cont(needle[i + len]))
+      ++len;
+    return len;
+  }
+
+  bool unit_at(std::size_t i, std::size_t len, std::size_t j) const
+  {
+    if (j + len > haystack.size())
+      return false;
+    for (std::size_t k = 0; k < len; ++k) {
+      if (!eq(i + k, j + k))
+        return false;
+    }
+    return true;
+  }
+
+  // finds the first occurrence of the unit at `i` in haystack[j..].
+  std::size_t find_unit(std::size_t i, std::size_t len, std::size_t j) const
+  {
+    unsigned char const c = needle[i];
+    if (case_sensitive || (!is_lower(c) && !is_upper(c))) {
+      while (j < haystack.size()) {
+        auto p = static_cast<char const*>(std::memchr(haystack.data() + j, c, haystack.size() - j));
+        if (p == nullptr)
+          break;
+        j = p - haystack.data();
+        if (unit_at(i, len, j))
+          return j;
+        ++j;
+      }
+      return std::string_view::npos;
+    }
+
+    unsigned char const lower = fold(c);
+    for (; j < haystack.size(); ++j) {
+      if (fold(haystack[j]) == lower)
+        return j;
+    }
+    return std::string_view::npos;
+  }
+
+  // checks that needle is a subsequence, and narrows the columns the DP has to visit to [first, last].
+  bool locate(std::size_t& first, std::size_t& last) const
+  {
+    std::size_t j = 0, i = 0, len = 0;
+    while (i < needle.size()) {
+      len = unit_length(i);
+      j = find_unit(i, len, j);
+      if (j == std::string_view::npos)
+        return false;
+      if (i == 0)
+        first = j;
+      i += len;
+      j += len;
+    }
+
+    // the last unit may also match further right.
+    std::size_t const tail = needle.size() - len;
+    last = j - 1;
+    for (std::size_t k = haystack.size() - len; k > j - len; --k) {
+      if (unit_at(tail, len, k)) {
+        last = k + len - 1;
+        break;
+      }
+    }
+    return true;
+  }
+};
+
+} // namespace
+
+bool fuzzy_match(std::string_view needle, std::string_view haystack, bool case_sensitive, double& score)
+{
+  Matcher matcher{needle, haystack, case_sensitive};
+
+  std::size_t first = 0, last = 0;
+  if (needle.empty() || !matcher.locate(first, last)) {
+    return false;
+  }
+
+  std::size_t const m = needle.size();
+  std::size_t const n = haystack.size();
+  if (m == n) {
+    score = m * score_match_consecutive;
+    return true;
+  }
+
+  std::size_t const w = last - first + 1;
+  if (w > max_window) {
+    score = (n - m) * score_gap_inner;
+    return true;
+  }
+
+  // D: the best score ending with a match of needle[i] at haystack[j].
+  // M: the best score of needle[..i] within haystack[..j].
+  thread_local std::vector<double> d_prev, m_prev, d_cur, m_cur;
+  d_prev.assign(w, score_none);
+  m_prev.assign(w, score_none);
+  d_cur.resize(w);
+  m_cur.resize(w);
+
+  for (std::size_t i = 0; i < m; ++i) {
+    // continuation bytes of a multibyte character must follow the preceding byte.
+    bool const cont = is_utf8_cont(needle[i]);
+    double const gap = (i == m - 1) ? score_gap_trailing : score_gap_inner;
+    double prev = score_none;
+
+    for (std::size_t k = 0; k < w; ++k) {
+      std::size_t const j = first + k;
+      double s = score_none;
+      if (matcher.eq(i, j)) {
+        if (i == 0) {
+          s = j * score_gap_leading + bonus_at(haystack, j);
+        }
+        else if (k > 0) {
+          s = d_prev[k - 1] + score_match_consecutive;
+          if (!cont) {
+            s = std::max(s, m_prev[k - 1] + bonus_at(haystack, j));
+          }
+        }
+      }
+      d_cur[k] = s;
+      m_cur[k] = prev = std::max(s, prev + gap);
+    }
+    std::swap(d_prev, d_cur);
+    std::swap(m_prev, m_cur);
+  }
+
+  score = m_prev[w - 1] + (n - 1 - last) * score_gap_trailing;
+  return true;
+}
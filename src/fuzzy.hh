@@ -0,0 +1,13 @@
+#ifndef __HEADER_FUZZY__
+#define __HEADER_FUZZY__
+
+#include <string_view>
+
+// scores `haystack` against `needle` as a subsequence match, in the manner of fzy:
+// consecutive matches and matches at the start of words, path components or camelCase humps are rewarded,
+// and gaps between matches are penalized. the result grows roughly by 1 per matched byte at best.
+// returns false if `needle` is not a subsequence of `haystack`.
+// unless `case_sensitive` is set, ASCII letters are compared case-insensitively.
+bool fuzzy_match(std::string_view needle, std::string_view haystack, bool case_sensitive, double& score);
+
+#endif
@@ -0,0 +1,130 @@
+#include "ingest.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "ansi.hh"
+#include "mapped_file.hh"
+
+constexpr std::size_t max_batch_size = 4096;
+
+// lines of a mapped file are cheap to index, so they are published in larger batches, each with a single store.
+constexpr std::size_t max_mapped_batch_size = 65536;
+
+void read_lines(std::istream& is, std::size_t max_len, std::function<void(LineStore const& batch)> const& consume)
+{
+  LineStore batch;
+  std::string stripped;
+  std::size_t count = 0;
+  for (std::string line; count < max_len && std::getline(is, line); ++count) {
+    batch.push_back(strip_ansi(line, stripped) ? stripped : line);
+    if (batch.size() >= max_batch_size || is.rdbuf()->in_avail() <= 0) {
+      consume(batch);
+      batch.clear();
+    }
+  }
+  if (!batch.empty()) {
+    consume(batch);
+  }
+}
+
+// indexes the lines of a mapped file in place. only lines containing escape sequences are copied.
+static void read_mapped_lines(std::shared_ptr<MappedFile> file, std::size_t max_len, LineStore& lines,
+                              sender<bool>& tx)
+{
+  std::vector<std::string_view> batch;
+  LineStore stripped;
+  std::vector<bool> escaped;
+  auto flush = [&] {
+    for (std::size_t i = 0, j = 0; i < batch.size(); ++i) {
+      if (escaped[i]) {
+        lines.stage(stripped[j++]);
+      }
+      else {
+        lines.stage_borrowed(batch[i]);
+      }
+    }
+    lines.commit();
+    batch.clear();
+    stripped.clear();
+    escaped.clear();
+    tx.send(true);
+  };
+
+  lines.keep_alive(file);
+
+  std::string buf;
+  char const* p = file->data();
+  char const* end = p + file->size();
+  for (std::size_t count = 0; p < end && count < max_len; ++count) {
+    auto eol = static_cast<char const*>(std::memchr(p, '\n', end - p));
+    if (eol == nullptr) {
+      eol = end;
+    }
+    batch.emplace_back(p, eol - p);
+    escaped.push_back(strip_ansi(batch.back(), buf));
+    if (escaped.back()) {
+      stripped.push_back(buf);
+    }
+    p = std::min(eol + 1, end);
+
+    if (batch.size() >= max_mapped_batch_size) {
+      flush();
+    }
+  }
+  if (!batch.empty()) {
+    flush();
+  }
+}
+
+// adds the lines of an indexed file, which are only copied if they contain escape sequences.
+static void read_indexed_lines(TrigramIndex const& index, std::size_t max_len, LineStore& lines, sender<bool>& tx)
+{
+  lines.keep_alive(index.mapped_file());
+
+  std::string stripped;
+  auto escaped = index.escaped_begin();
+  std::size_t const num_lines = std::min(index.num_lines(), max_len);
+  for (std::size_t i = 0; i < num_lines;) {
+    for (std::size_t end = std::min(num_lines, i + max_mapped_batch_size); i < end; ++i) {
+      if (escaped != index.escaped_end() && *escaped == i) {
+        strip_ansi(index.line(i), stripped);
+        lines.stage(stripped);
+        ++escaped;
+      }
+      else {
+        lines.stage_borrowed(index.line(i));
+      }
+    }
+    lines.commit();
+    tx.send(true);
+  }
+}
+
+std::thread spawn_reader(std::string const& file, std::size_t max_buffer, std::shared_ptr<LineStore> lines,
+                         sender<bool> tx, std::shared_ptr<TrigramIndex const> index)
+{
+  return std::thread([=]() mutable {
+    auto append = [&](LineStore const& batch) {
+      lines->append(batch);
+      tx.send(true);
+    };
+
+    if (index) {
+      read_indexed_lines(*index, max_buffer, *lines, tx);
+    }
+    else if (file.empty()) {
+      read_lines(std::cin, max_buffer, append);
+    }
+    else if (auto mapped = MappedFile::open(file)) {
+      read_mapped_lines(std::move(mapped), max_buffer, *lines, tx);
+    }
+    else {
+      // pipes and other special files cannot be mapped.
+      std::ifstream ifs{file};
+      read_lines(ifs, max_buffer, append);
+    }
+    tx.send(false);
+  });
+}
@@ -0,0 +1,24 @@
+#ifndef __HEADER_INGEST__
+#define __HEADER_INGEST__
+
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <thread>
+#include "channel.hh"
+#include "line_store.hh"
+#include "trigram_index.hh"
+
+// reads at most `max_len` lines from `is` and passes them to `consume` in batches.
+// a batch is handed over when it is full or when no more input is buffered,
+// so that lines from a slow producer show up without delay.
+void read_lines(std::istream& is, std::size_t max_len, std::function<void(LineStore const& batch)> const& consume);
+
+// starts a thread which reads candidates from `file` (or stdin if empty) and appends them to `lines`.
+// `tx` is sent `true` after each appended batch and `false` once the input is exhausted.
+// given the index of `file`, lines are taken from its line table without scanning the file.
+std::thread spawn_reader(std::string const& file, std::size_t max_buffer, std::shared_ptr<LineStore> lines,
+                         sender<bool> tx, std::shared_ptr<TrigramIndex const> index = nullptr);
+
+#endif
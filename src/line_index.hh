@@ -0,0 +1,33 @@
+#ifndef __HEADER_LINE_INDEX__
+#define __HEADER_LINE_INDEX__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "search.hh"
+
+// an index which tells the lines that may contain some substrings, so that the others are not scored.
+class LineIndex {
+public:
+  virtual ~LineIndex() = default;
+
+  // puts the lines in [first, last) which may contain all of `substrings` (ignoring the case of ASCII letters)
+  // into `out` in ascending order. returns false and leaves `out` alone if the index cannot narrow them down,
+  // in which case every line is a candidate.
+  virtual bool lookup(std::vector<std::string> const& substrings, std::size_t first, std::size_t last,
+                      std::vector<std::uint32_t>& out) const = 0;
+
+  // the number of lines the index knows of.
+  virtual std::size_t num_lines() const noexcept = 0;
+};
+
+// the trigram at `p` as an integer, with ASCII letters lower-cased.
+inline std::uint32_t trigram_key(char const* p)
+{
+  return static_cast<std::uint32_t>(static_cast<unsigned char>(fold_ascii(p[0]))) << 16 |
+         static_cast<std::uint32_t>(static_cast<unsigned char>(fold_ascii(p[1]))) << 8 |
+         static_cast<std::uint32_t>(static_cast<unsigned char>(fold_ascii(p[2])));
+}
+
+#endif
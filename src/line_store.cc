@@ -0,0 +1,110 @@
+#include "line_store.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+// lines longer than this get a slab of their own.
+constexpr std::size_t slab_size = 1 << 20;
+
+LineStore::LineStore(LineStore&& other) noexcept { *this = std::move(other); }
+
+LineStore& LineStore::operator=(LineStore&& other) noexcept
+{
+  slabs = std::move(other.slabs);
+  segments = std::move(other.segments);
+  length = std::exchange(other.length, 0);
+  published.store(other.published.exchange(0));
+  owners = std::move(other.owners);
+  current = std::exchange(other.current, 0);
+  head = std::exchange(other.head, nullptr);
+  rest = std::exchange(other.rest, 0);
+  return *this;
+}
+
+void LineStore::push_back(std::string_view line)
+{
+  stage(line);
+  publish();
+}
+
+void LineStore::push_back_borrowed(std::string_view line)
+{
+  stage_borrowed(line);
+  publish();
+}
+
+void LineStore::stage(std::string_view line)
+{
+  // a line longer than 4GiB is truncated.
+  std::size_t len = std::min<std::size_t>(line.size(), std::numeric_limits<std::uint32_t>::max());
+  char* data = allocate(len);
+  std::memcpy(data, line.data(), len);
+  add_entry(data, len);
+}
+
+void LineStore::stage_borrowed(std::string_view line)
+{
+  std::size_t len = std::min<std::size_t>(line.size(), std::numeric_limits<std::uint32_t>::max());
+  add_entry(line.data(), len);
+}
+
+void LineStore::append(LineStore const& other)
+{
+  std::size_t const n = other.size();
+  for (std::size_t i = 0; i < n; ++i) {
+    auto line = other[i];
+    char* data = allocate(line.size());
+    std::memcpy(data, line.data(), line.size());
+    add_entry(data, line.size());
+  }
+  publish();
+}
+
+void LineStore::clear()
+{
+  length = 0;
+  publish();
+  owners.clear();
+  // only the slab lines are currently packed into is kept; the others, including those of long lines, are freed.
+  if (head == nullptr) {
+    slabs.clear();
+    return;
+  }
+  std::swap(slabs[0], slabs[current]);
+  slabs.resize(1);
+  current = 0;
+  head = slabs[0].get();
+  rest = slab_size;
+}
+
+void LineStore::add_entry(char const* data, std::size_t len)
+{
+  // a new segment is allocated when the last one gets full. readers never see it until it is published.
+  std::size_t const i = length;
+  std::size_t k = 63 - __builtin_clzll(i / first_segment_size + 1);
+  if (!segments[k]) {
+    segments[k].reset(new Entry[first_segment_size << k]);
+  }
+  segments[k][i - first_segment_size * ((std::size_t{1} << k) - 1)] = Entry{data, static_cast<std::uint32_t>(len)};
+  ++length;
+}
+
+char* LineStore::allocate(std::size_t len)
+{
+  if (len > slab_size) {
+    slabs.emplace_back(new char[len]);
+    return slabs.back().get();
+  }
+  if (head == nullptr || rest < len) {
+    slabs.emplace_back(new char[slab_size]);
+    current = slabs.size() - 1;
+    head = slabs.back().get();
+    rest = slab_size;
+  }
+  char* data = head;
+  head += len;
+  rest -= len;
+  return data;
+}
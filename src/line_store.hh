@@ -0,0 +1,102 @@
+#ifndef __HEADER_LINE_STORE__
+#define __HEADER_LINE_STORE__
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// an append-only sequence of lines, which one thread appends to while others read it without locking.
+//
+// the bytes of lines are packed into large slabs, and their entries into segments of doubling size.
+// neither of them is moved once allocated, so that views returned by `operator[]` remain valid while the store grows.
+// the number of lines is published by a release store after their entries are written, so a reader which has
+// taken size() (or a snapshot) may read any line before it while the writer keeps appending.
+// everything else, e.g. clear() and moving the store, must not race with readers.
+class LineStore {
+  struct Entry {
+    char const* data;
+    std::uint32_t size;
+  };
+
+  // the segment `k` holds the entries from `first_segment_size * (2^k - 1)`, and has `first_segment_size * 2^k` of them.
+  static constexpr std::size_t first_segment_size = 1024;
+  static constexpr std::size_t max_segments = 40;
+
+  std::vector<std::unique_ptr<char[]>> slabs;
+  std::array<std::unique_ptr<Entry[]>, max_segments> segments;
+  std::size_t length = 0; // seen only by the writer.
+  std::atomic<std::size_t> published{0};
+
+  // external memory which borrowed lines refer to.
+  std::vector<std::shared_ptr<void const>> owners;
+
+  // the unused part of the slab which lines are currently packed into.
+  std::size_t current = 0;
+  char* head = nullptr;
+  std::size_t rest = 0;
+
+public:
+  // the lines published at some point. it is immutable, as lines are only appended.
+  class Snapshot {
+    LineStore const* store = nullptr;
+    std::size_t length = 0;
+
+  public:
+    Snapshot() = default;
+    Snapshot(LineStore const& store, std::size_t length) : store{&store}, length{length} {}
+
+    std::size_t size() const noexcept { return length; }
+    bool empty() const noexcept { return length == 0; }
+    std::string_view operator[](std::size_t i) const noexcept { return (*store)[i]; }
+  };
+
+  LineStore() = default;
+  LineStore(LineStore const&) = delete;
+  LineStore& operator=(LineStore const&) = delete;
+  LineStore(LineStore&& other) noexcept;
+  LineStore& operator=(LineStore&& other) noexcept;
+
+  void push_back(std::string_view line);
+  // publishes the lines of `other` at once.
+  void append(LineStore const& other);
+
+  // adds a line without copying its bytes, e.g. a line in a mapped file.
+  // the memory must be kept alive by an owner registered with `keep_alive()`.
+  void push_back_borrowed(std::string_view line);
+  void keep_alive(std::shared_ptr<void const> owner) { owners.push_back(std::move(owner)); }
+
+  // add lines as push_back() and push_back_borrowed() do, but leave them unpublished until commit(),
+  // so that a batch costs a single release store and readers never see a part of it.
+  void stage(std::string_view line);
+  void stage_borrowed(std::string_view line);
+  void commit() { publish(); }
+
+  // removes all lines and releases their owners, keeping one regular slab and the segments for reuse.
+  void clear();
+
+  std::size_t size() const noexcept { return published.load(std::memory_order_acquire); }
+  bool empty() const noexcept { return size() == 0; }
+  Snapshot snapshot() const noexcept { return {*this, size()}; }
+
+  std::string_view operator[](std::size_t i) const noexcept
+  {
+    Entry const& e = entry(i);
+    return {e.data, e.size};
+  }
+
+private:
+  char* allocate(std::size_t len);
+  void add_entry(char const* data, std::size_t len);
+  void publish() { published.store(length, std::memory_order_release); }
+
+  Entry const& entry(std::size_t i) const noexcept
+  {
+    std::size_t k = 63 - __builtin_clzll(i / first_segment_size + 1);
+    return segments[k][i - first_segment_size * ((std::size_t{1} << k) - 1)];
+  }
+};
+
+#endif
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include "line_store.hh"
+
+TEST(line_store_test, push_back)
+{
+  LineStore lines;
+  lines.push_back("foo");
+  lines.push_back("");
+  lines.push_back(u8"ほげ");
+
+  ASSERT_EQ(3, lines.size());
+  EXPECT_EQ("foo", lines[0]);
+  EXPECT_EQ("", lines[1]);
+  EXPECT_EQ(u8"ほげ", lines[2]);
+}
+
+TEST(line_store_test, views_survive_growth)
+{
+  LineStore lines;
+  std::string large(3 << 20, 'x');
+  lines.push_back("first");
+  auto first = lines[0];
+
+  lines.push_back(large);
+  for (int i = 0; i < 100000; ++i) {
+    lines.push_back(std::to_string(i));
+  }
+
+  EXPECT_EQ("first", first);
+  EXPECT_EQ(large, lines[1]);
+  EXPECT_EQ("99999", lines[lines.size() - 1]);
+}
+
+TEST(line_store_test, append_and_clear)
+{
+  LineStore batch, all;
+  batch.push_back("a");
+  batch.push_back("b");
+  all.append(batch);
+
+  batch.clear();
+  EXPECT_TRUE(batch.empty());
+  batch.push_back("c");
+  all.append(batch);
+
+  ASSERT_EQ(3, all.size());
+  EXPECT_EQ("a", all[0]);
+  EXPECT_EQ("b", all[1]);
+  EXPECT_EQ("c", all[2]);
+}
+
+TEST(line_store_test, across_segments)
+{
+  LineStore lines;
+  for (int i = 0; i < 10000; ++i) {
+    lines.push_back(std::to_string(i));
+  }
+  ASSERT_EQ(10000, lines.size());
+  for (int i : {0, 1023, 1024, 3071, 3072, 7167, 7168, 9999}) {
+    EXPECT_EQ(std::to_string(i), lines[i]);
+  }
+
+  // a snapshot does not see lines appended later.
+  auto snapshot = lines.snapshot();
+  lines.push_back("next");
+  EXPECT_EQ(10000, snapshot.size());
+  EXPECT_EQ("9999", snapshot[9999]);
+  EXPECT_EQ("next", lines[10000]);
+
+  // segments are kept for reuse.
+  lines.clear();
+  EXPECT_TRUE(lines.empty());
+  lines.push_back("again");
+  EXPECT_EQ("again", lines[0]);
+}
+
+TEST(line_store_test, staged_lines)
+{
+  LineStore lines;
+  std::string borrowed = "bar";
+  lines.stage("foo");
+  lines.stage_borrowed(borrowed);
+  // readers see none of them until they are committed.
+  EXPECT_EQ(0, lines.size());
+  lines.commit();
+  ASSERT_EQ(2, lines.size());
+  EXPECT_EQ("foo", lines[0]);
+  EXPECT_EQ("bar", lines[1]);
+  EXPECT_EQ(borrowed.data(), lines[1].data());
+}
+
+TEST(line_store_test, clear_releases_long_lines_and_owners)
+{
+  LineStore lines;
+  auto owner = std::make_shared<std::string>("owned");
+  lines.keep_alive(owner);
+  lines.push_back_borrowed(*owner);
+  lines.push_back(std::string(3 << 20, 'x'));
+
+  lines.clear();
+  EXPECT_EQ(1, owner.use_count());
+
+  // a store holding only long lines has no regular slab to keep.
+  lines.push_back(std::string(3 << 20, 'y'));
+  lines.clear();
+  lines.push_back("short");
+  lines.push_back(std::string(3 << 20, 'z'));
+  ASSERT_EQ(2, lines.size());
+  EXPECT_EQ("short", lines[0]);
+  EXPECT_EQ(std::string(3 << 20, 'z'), lines[1]);
+}
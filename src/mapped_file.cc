@@ -0,0 +1,42 @@
+#include "mapped_file.hh"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile()
+{
+  if (addr != nullptr) {
+    ::munmap(addr, length);
+  }
+}
+
+std::shared_ptr<MappedFile> MappedFile::open(std::string const& path)
+{
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    ::close(fd);
+    return nullptr;
+  }
+
+  std::size_t length = static_cast<std::size_t>(st.st_size);
+  if (length == 0) {
+    ::close(fd);
+    return std::shared_ptr<MappedFile>(new MappedFile(nullptr, 0));
+  }
+
+  void* addr = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    return nullptr;
+  }
+  ::madvise(addr, length, MADV_SEQUENTIAL);
+
+  return std::shared_ptr<MappedFile>(new MappedFile(addr, length));
+}
@@ -0,0 +1,30 @@
+#ifndef __HEADER_MAPPED_FILE__
+#define __HEADER_MAPPED_FILE__
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// a read-only memory mapping of a whole regular file.
+class MappedFile {
+  void* addr = nullptr;
+  std::size_t length = 0;
+
+  MappedFile(void* addr, std::size_t length) : addr{addr}, length{length} {}
+
+public:
+  MappedFile(MappedFile const&) = delete;
+  MappedFile& operator=(MappedFile const&) = delete;
+  ~MappedFile();
+
+  // maps the file at `path`. returns nullptr if it is not a regular file or cannot be mapped,
+  // e.g. pipes and character devices, which must be read as a stream instead.
+  static std::shared_ptr<MappedFile> open(std::string const& path);
+
+  char const* data() const noexcept { return static_cast<char const*>(addr); }
+  std::size_t size() const noexcept { return length; }
+  std::string_view view() const noexcept { return {data(), size()}; }
+};
+
+#endif
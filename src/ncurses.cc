@@ -1,6 +1,8 @@
 #include "ncurses.hh"
 
+#include <array>
 #include <ncurses.h>
+#include <poll.h>
 #include <stdexcept>
 #include "utf8.hh"
 
@@ -67,14 +69,61 @@ std::tuple<int, int> Window::get_size() const
   return std::make_tuple(width, height);
 }
 
-void Window::add_str(int x, int y, std::string const& text) { mvwaddstr(win, y, x, text.c_str()); }
+void Window::add_str(int x, int y, std::string_view text)
+{
+  mvwaddnstr(win, y, x, text.data(), static_cast<int>(text.size()));
+}
+
+void Window::clear_line(int x, int y)
+{
+  ::wmove(win, y, x);
+  ::wclrtoeol(win);
+}
+
+void Window::move_cursor(int x, int y) { ::wmove(win, y, x); }
 
 void Window::change_attr(int x, int y, int n, int col) { mvwchgat(win, y, x, n, A_BOLD | A_UNDERLINE, col, nullptr); }
 
+bool Window::bytes_written(std::size_t& bytes) const
+{
+#ifdef __linux__
+  // ncurses writes to the file descriptor by itself rather than through `tty_out`, so the bytes are taken
+  // from the I/O accounting of the calling thread, which is the only one drawing the screen.
+  // the file is kept open, and read again from the start.
+  if (!io) {
+    io.reset(::fopen("/proc/thread-self/io", "r"));
+  }
+  else {
+    std::rewind(io.get());
+  }
+  char key[32];
+  while (io && std::fscanf(io.get(), "%31s %zu", key, &bytes) == 2) {
+    if (std::string_view{key} == "wchar:") {
+      return true;
+    }
+  }
+#endif
+  (void)bytes;
+  return false;
+}
+
+void Window::wait_event(int fd)
+{
+  // ncurses reads the terminal byte by byte, so no key is left in its buffer once poll_event() returns Key::None.
+  std::array<pollfd, 2> fds{{{::fileno(tty_in.get()), POLLIN, 0}, {fd, POLLIN, 0}}};
+  ::poll(fds.data(), fd >= 0 ? 2 : 1, -1);
+}
+
 Event Window::poll_event()
 {
   int ch = ::wgetch(win);
-  if (ch == 10) {
+  if (ch == ERR) {
+    return Event{Key::None};
+  }
+  else if (ch == KEY_RESIZE) {
+    return Event{Key::Resize};
+  }
+  else if (ch == 10) {
     return Event{Key::Enter};
   }
   else if (ch == 27) {
@@ -2,6 +2,7 @@
 #define __HEADER_NCURSE__
 
 #include <string>
+#include <string_view>
 #include <cstdio>
 #include <memory>
 
@@ -13,7 +14,7 @@ typedef struct _win_st WINDOW;
 
 namespace curses {
 
-enum class Key { Enter, Esc, Ctrl, Alt, Up, Down, Left, Right, Tab, Backspace, Char, Unknown };
+enum class Key { Enter, Esc, Ctrl, Alt, Up, Down, Left, Right, Tab, Backspace, Char, Resize, None, Unknown };
 
 class Event {
   Key key;
@@ -38,6 +39,8 @@ class Window {
   };
 
   std::unique_ptr<FILE, deleter_t> tty_in, tty_out;
+  // the I/O accounting of the drawing thread, opened by the first call of bytes_written().
+  mutable std::unique_ptr<FILE, deleter_t> io;
   SCREEN* scr = nullptr;
   WINDOW* win = nullptr;
 
@@ -46,14 +49,26 @@ public:
   Window(Window&&) noexcept = default;
   ~Window();
 
+  // blocks until a key is pressed or `fd` gets readable, unless `fd` is negative.
+  // also returns when interrupted by a signal, e.g. SIGWINCH.
+  void wait_event(int fd = -1);
+  // returns the next key without blocking, or Key::None if no key is pending.
   Event poll_event();
 
   void erase();
   void refresh();
   std::tuple<int, int> get_size() const;
-  void add_str(int x, int y, std::string const& text);
+  void add_str(int x, int y, std::string_view text);
+  // clears the row `y` from the column `x` to the right end.
+  void clear_line(int x, int y);
+  // moves the cursor shown on the terminal after the next refresh().
+  void move_cursor(int x, int y);
 
   void change_attr(int x, int y, int n, int col);
+
+  // stores the total number of bytes written to the terminal so far to `bytes`.
+  // returns false if it cannot be told, i.e. on other platforms than Linux.
+  bool bytes_written(std::size_t& bytes) const;
 };
 
 } // namespace curses;
@@ -0,0 +1,316 @@
+#include "ngram_index.hh"
+
+#include <algorithm>
+
+// bigrams are told from trigrams by a bit above the 24 bits of a trigram.
+constexpr std::uint32_t bigram_flag = std::uint32_t{1} << 24;
+constexpr std::uint32_t skip_interval = 64;
+constexpr std::uint32_t dense_ratio = 8;
+constexpr std::uint32_t min_dense_count = 256;
+// the bytes taken by an n-gram besides its postings, i.e. its slots, key and Postings.
+constexpr std::size_t ngram_overhead = 2 * sizeof(std::uint32_t) + sizeof(std::uint32_t) + 64;
+// the memory limit is checked at this interval of lines.
+constexpr std::size_t check_interval = 1024;
+
+static std::uint32_t bigram_key(char const* p)
+{
+  return bigram_flag | static_cast<std::uint32_t>(static_cast<unsigned char>(fold_ascii(p[0]))) << 8 |
+         static_cast<std::uint32_t>(static_cast<unsigned char>(fold_ascii(p[1])));
+}
+
+static std::size_t hash_slot(std::uint32_t key, std::size_t mask) { return (key * 0x9E3779B1u) & mask; }
+
+struct NgramIndex::Postings {
+  struct Skip {
+    std::uint32_t line;
+    std::uint32_t offset; // where the posting after it starts.
+  };
+
+  // sparse lists are varints, and lists of more than one line in `dense_ratio` turn into bitmaps.
+  std::vector<std::uint8_t> bytes;
+  std::vector<Skip> skips; // for every `skip_interval`th posting.
+  std::vector<std::uint64_t> bits;
+  std::uint32_t count = 0;
+  std::uint32_t next = 0; // the last line plus one, which the next posting is relative to.
+
+  bool dense() const noexcept { return !bits.empty(); }
+  std::size_t footprint() const noexcept
+  {
+    return bytes.size() + skips.size() * sizeof(Skip) + bits.size() * sizeof(std::uint64_t);
+  }
+
+  void add(std::uint32_t line)
+  {
+    ++count;
+    if (dense()) {
+      set(line);
+      next = line + 1;
+      return;
+    }
+
+    for (std::uint32_t delta = line - next;; delta >>= 7) {
+      if (delta < 0x80) {
+        bytes.push_back(static_cast<std::uint8_t>(delta));
+        break;
+      }
+      bytes.push_back(static_cast<std::uint8_t>(delta | 0x80));
+    }
+    next = line + 1;
+    if ((count - 1) % skip_interval == 0) {
+      skips.push_back(Skip{line, static_cast<std::uint32_t>(bytes.size())});
+    }
+    if (count >= min_dense_count && bytes.size() > line / dense_ratio) {
+      to_bitmap();
+    }
+  }
+
+private:
+  void set(std::uint32_t line)
+  {
+    if (line / 64 >= bits.size()) {
+      bits.resize(line / 64 + 1);
+    }
+    bits[line / 64] |= std::uint64_t{1} << (line % 64);
+  }
+
+  void to_bitmap()
+  {
+    std::vector<std::uint32_t> lines;
+    std::uint32_t line = 0;
+    for (std::size_t offset = 0; offset < bytes.size();) {
+      std::uint32_t delta = 0;
+      for (int shift = 0;; shift += 7) {
+        std::uint8_t b = bytes[offset++];
+        delta |= static_cast<std::uint32_t>(b & 0x7F) << shift;
+        if (b < 0x80) {
+          break;
+        }
+      }
+      line = (lines.empty() ? 0 : line + 1) + delta;
+      lines.push_back(line);
+    }
+    bits.resize(lines.back() / 64 + 1);
+    for (auto l : lines) {
+      set(l);
+    }
+    std::vector<std::uint8_t>().swap(bytes);
+    std::vector<Skip>().swap(skips);
+  }
+};
+
+// walks the postings of an n-gram in ascending order.
+class NgramIndex::Cursor {
+  Postings const* list;
+  std::size_t offset = 0;
+  std::uint32_t index = 0; // the number of postings read.
+  std::uint32_t next = 0;
+
+public:
+  std::uint32_t line = 0;
+
+  explicit Cursor(Postings const* list) : list{list} {}
+  std::uint32_t size() const noexcept { return list->count; }
+
+  // moves to the first line not less than `target`. returns false if there is none.
+  bool seek(std::uint32_t target)
+  {
+    if (index > 0 && line >= target) {
+      return true;
+    }
+    return list->dense() ? seek_bit(target) : seek_varint(target);
+  }
+
+private:
+  bool seek_bit(std::uint32_t target)
+  {
+    auto& bits = list->bits;
+    std::size_t w = target / 64;
+    if (w >= bits.size()) {
+      return false;
+    }
+    std::uint64_t word = bits[w] & (~std::uint64_t{0} << (target % 64));
+    while (word == 0) {
+      if (++w == bits.size()) {
+        return false;
+      }
+      word = bits[w];
+    }
+    line = static_cast<std::uint32_t>(w * 64 + __builtin_ctzll(word));
+    index = 1;
+    return true;
+  }
+
+  bool seek_varint(std::uint32_t target)
+  {
+    // jumps to the last skip before `target` if it is ahead.
+    auto& skips = list->skips;
+    auto k = std::upper_bound(skips.begin(), skips.end(), target, [](std::uint32_t t, auto& s) { return t < s.line; }) -
+             skips.begin();
+    if (k > 0 && (k - 1) * skip_interval + 1 > index) {
+      line = skips[k - 1].line;
+      offset = skips[k - 1].offset;
+      index = static_cast<std::uint32_t>((k - 1) * skip_interval + 1);
+      next = line + 1;
+      if (line >= target) {
+        return true;
+      }
+    }
+    while (index < list->count) {
+      std::uint32_t delta = 0;
+      for (int shift = 0;; shift += 7) {
+        std::uint8_t b = list->bytes[offset++];
+        delta |= static_cast<std::uint32_t>(b & 0x7F) << shift;
+        if (b < 0x80) {
+          break;
+        }
+      }
+      line = next + delta;
+      next = line + 1;
+      ++index;
+      if (line >= target) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+NgramIndex::NgramIndex() : slots(1024) {}
+NgramIndex::NgramIndex(NgramIndex&&) noexcept = default;
+NgramIndex::~NgramIndex() = default;
+
+void NgramIndex::add(std::uint32_t key, std::uint32_t line)
+{
+  std::size_t const mask = slots.size() - 1;
+  std::size_t i = hash_slot(key, mask);
+  for (; slots[i] != 0; i = (i + 1) & mask) {
+    auto& list = postings[slots[i] - 1];
+    if (keys[slots[i] - 1] == key) {
+      // an n-gram appearing twice in a line.
+      if (list.next != line + 1) {
+        std::size_t before = list.footprint();
+        list.add(line);
+        memory = memory + list.footprint() - before;
+      }
+      return;
+    }
+  }
+
+  keys.push_back(key);
+  postings.emplace_back();
+  postings.back().add(line);
+  memory += ngram_overhead + postings.back().footprint();
+  slots[i] = static_cast<std::uint32_t>(keys.size());
+  if (keys.size() * 2 > slots.size()) {
+    grow();
+  }
+}
+
+void NgramIndex::grow()
+{
+  memory += slots.size() * sizeof(std::uint32_t);
+  slots.assign(slots.size() * 2, 0);
+  std::size_t const mask = slots.size() - 1;
+  for (std::size_t k = 0; k < keys.size(); ++k) {
+    std::size_t i = hash_slot(keys[k], mask);
+    while (slots[i] != 0) {
+      i = (i + 1) & mask;
+    }
+    slots[i] = static_cast<std::uint32_t>(k + 1);
+  }
+}
+
+auto NgramIndex::find(std::uint32_t key) const -> Postings const*
+{
+  std::size_t const mask = slots.size() - 1;
+  for (std::size_t i = hash_slot(key, mask); slots[i] != 0; i = (i + 1) & mask) {
+    if (keys[slots[i] - 1] == key) {
+      return &postings[slots[i] - 1];
+    }
+  }
+  return nullptr;
+}
+
+std::unique_ptr<NgramIndex> NgramIndex::build(LineStore::Snapshot lines, std::size_t memory_limit,
+                                              std::atomic<bool> const& cancelled)
+{
+  auto index = std::make_unique<NgramIndex>();
+  std::size_t i = 0;
+  for (; i < lines.size(); ++i) {
+    if (i % check_interval == 0) {
+      if (cancelled.load(std::memory_order_relaxed)) {
+        return nullptr;
+      }
+      if (index->memory >= memory_limit) {
+        break;
+      }
+    }
+    auto line = lines[i];
+    auto n = static_cast<std::uint32_t>(i);
+    for (std::size_t k = 0; k + 2 <= line.size(); ++k) {
+      index->add(bigram_key(line.data() + k), n);
+      if (k + 3 <= line.size()) {
+        index->add(trigram_key(line.data() + k), n);
+      }
+    }
+  }
+  index->covered = i;
+
+  for (auto& list : index->postings) {
+    list.bytes.shrink_to_fit();
+    list.skips.shrink_to_fit();
+    list.bits.shrink_to_fit();
+  }
+  return index;
+}
+
+bool NgramIndex::lookup(std::vector<std::string> const& substrings, std::size_t first, std::size_t last,
+                        std::vector<std::uint32_t>& out) const
+{
+  std::vector<std::uint32_t> wanted;
+  for (auto& s : substrings) {
+    if (s.size() == 2) {
+      wanted.push_back(bigram_key(s.data()));
+    }
+    for (std::size_t i = 0; i + 3 <= s.size(); ++i) {
+      wanted.push_back(trigram_key(s.data() + i));
+    }
+  }
+  if (wanted.empty()) {
+    return false;
+  }
+  std::sort(wanted.begin(), wanted.end());
+  wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+
+  out.clear();
+  last = std::min(last, covered);
+  std::vector<Cursor> cursors;
+  for (auto key : wanted) {
+    auto list = find(key);
+    if (list == nullptr) {
+      return true;
+    }
+    cursors.emplace_back(list);
+  }
+  std::sort(cursors.begin(), cursors.end(), [](auto& a, auto& b) { return a.size() < b.size(); });
+
+  // every cursor is moved to the line the others have reached, until they agree on it.
+  auto target = static_cast<std::uint32_t>(first);
+  while (target < last) {
+    bool agreed = true;
+    for (auto& cursor : cursors) {
+      if (!cursor.seek(target)) {
+        return true;
+      }
+      if (cursor.line != target) {
+        target = cursor.line;
+        agreed = false;
+        break;
+      }
+    }
+    if (agreed) {
+      out.push_back(target++);
+    }
+  }
+  return true;
+}
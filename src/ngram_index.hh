@@ -0,0 +1,51 @@
+#ifndef __HEADER_NGRAM_INDEX__
+#define __HEADER_NGRAM_INDEX__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "line_index.hh"
+#include "line_store.hh"
+
+// an index of the bigrams and trigrams of lines in memory, built when the input has no file to keep an index of.
+//
+// the postings of each n-gram are kept as the differences between successive lines in varints,
+// with the position of every 64th posting on the side so that intersections skip over long lists.
+// n-grams found in more than one of every 8 lines are kept as bitmaps instead.
+// the build stops at a memory limit, and then the index covers the lines read so far.
+class NgramIndex : public LineIndex {
+  struct Postings;
+  class Cursor;
+
+  // an open-addressing table from n-grams to their postings.
+  std::vector<std::uint32_t> slots; // 1 + the position in `keys` and `postings`, or 0 if free.
+  std::vector<std::uint32_t> keys;
+  std::vector<Postings> postings;
+  std::size_t covered = 0;
+  std::size_t memory = 0;
+
+public:
+  NgramIndex();
+  NgramIndex(NgramIndex&&) noexcept;
+  ~NgramIndex();
+
+  // indexes `lines` until their postings take `memory_limit` bytes. returns nullptr if `cancelled` is set.
+  static std::unique_ptr<NgramIndex> build(LineStore::Snapshot lines, std::size_t memory_limit,
+                                           std::atomic<bool> const& cancelled);
+
+  // bigrams are looked up for substrings of two bytes, and trigrams for longer ones.
+  bool lookup(std::vector<std::string> const& substrings, std::size_t first, std::size_t last,
+              std::vector<std::uint32_t>& out) const override;
+  std::size_t num_lines() const noexcept override { return covered; }
+  // an estimate of the bytes taken by the index.
+  std::size_t memory_usage() const noexcept { return memory; }
+
+private:
+  void add(std::uint32_t key, std::uint32_t line);
+  Postings const* find(std::uint32_t key) const;
+  void grow();
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include "ngram_index.hh"
+
+static std::string fold(std::string s)
+{
+  std::transform(s.begin(), s.end(), s.begin(), fold_ascii);
+  return s;
+}
+
+// the lines containing every n-gram looked up for `substrings`.
+static std::vector<std::uint32_t> scan(LineStore const& lines, std::vector<std::string> const& substrings,
+                                       std::size_t first, std::size_t last)
+{
+  std::vector<std::uint32_t> result;
+  for (std::size_t i = first; i < last; ++i) {
+    auto line = fold(std::string(lines[i]));
+    bool all = true;
+    for (auto& s : substrings) {
+      auto n = s.size() == 2 ? 2 : 3;
+      for (std::size_t k = 0; k + n <= s.size() && all; ++k) {
+        all = line.find(fold(s.substr(k, n))) != std::string::npos;
+      }
+    }
+    if (all) {
+      result.push_back(static_cast<std::uint32_t>(i));
+    }
+  }
+  return result;
+}
+
+TEST(ngram_index_test, lookup)
+{
+  std::mt19937 rng(2);
+  auto random_string = [&](std::size_t len) {
+    static char const alphabet[] = "abcdABCD-";
+    std::string s;
+    for (std::size_t i = 0; i < len; ++i) {
+      s += alphabet[rng() % 9];
+    }
+    return s;
+  };
+
+  LineStore lines;
+  for (int i = 0; i < 20000; ++i) {
+    lines.push_back(random_string(rng() % 16));
+  }
+  std::atomic<bool> cancelled{false};
+  auto index = NgramIndex::build(lines.snapshot(), static_cast<std::size_t>(-1), cancelled);
+  ASSERT_NE(nullptr, index);
+  EXPECT_EQ(lines.size(), index->num_lines());
+
+  std::vector<std::uint32_t> found;
+  EXPECT_FALSE(index->lookup({"a", ""}, 0, lines.size(), found));
+
+  for (int n = 0; n < 300; ++n) {
+    std::vector<std::string> substrings{random_string(2 + rng() % 4)};
+    if (n % 3 == 0) {
+      substrings.push_back(random_string(2));
+    }
+    std::size_t first = rng() % lines.size();
+    std::size_t last = first + rng() % (lines.size() - first + 1);
+    ASSERT_TRUE(index->lookup(substrings, first, last, found));
+    EXPECT_EQ(scan(lines, substrings, first, last), found) << substrings[0];
+  }
+}
+
+TEST(ngram_index_test, memory_limit)
+{
+  LineStore lines;
+  for (int i = 0; i < 100000; ++i) {
+    lines.push_back("line " + std::to_string(i * 7919));
+  }
+  std::atomic<bool> cancelled{false};
+  auto index = NgramIndex::build(lines.snapshot(), 1 << 16, cancelled);
+  ASSERT_NE(nullptr, index);
+  EXPECT_LT(0, index->num_lines());
+  EXPECT_GT(lines.size(), index->num_lines());
+
+  // lines after the ones covered are not looked up.
+  std::vector<std::uint32_t> found;
+  ASSERT_TRUE(index->lookup({"ine"}, 0, lines.size(), found));
+  EXPECT_EQ(index->num_lines(), found.size());
+
+  cancelled = true;
+  EXPECT_EQ(nullptr, NgramIndex::build(lines.snapshot(), 1 << 16, cancelled));
+}
@@ -0,0 +1,70 @@
+#include "notifier.hh"
+
+#include <cerrno>
+#include <cstdint>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+Notifier::Notifier()
+{
+#ifdef __linux__
+  fds[0] = fds[1] = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (fds[0] < 0) {
+    throw std::runtime_error(std::string(__FUNCTION__) + ": failed to create an eventfd");
+  }
+#else
+  if (::pipe(fds) != 0) {
+    throw std::runtime_error(std::string(__FUNCTION__) + ": failed to create a pipe");
+  }
+  for (int fd : fds) {
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+#endif
+}
+
+Notifier::~Notifier()
+{
+  ::close(fds[0]);
+  if (fds[1] != fds[0]) {
+    ::close(fds[1]);
+  }
+}
+
+void Notifier::notify() noexcept
+{
+  if (pending.exchange(true)) {
+    return;
+  }
+  // EAGAIN means the counter or the pipe is full, which is as readable as it gets.
+  std::uint64_t one = 1;
+  while (::write(fds[1], &one, fds[0] == fds[1] ? sizeof(one) : 1) < 0 && errno == EINTR) {
+  }
+}
+
+void Notifier::drain() noexcept
+{
+  char buf[256];
+  while (true) {
+    ssize_t n = ::read(fds[0], buf, sizeof(buf));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    // an eventfd is reset by a single read.
+    if (n < static_cast<ssize_t>(sizeof(buf)) || fds[0] == fds[1]) {
+      break;
+    }
+  }
+
+  // cleared only after the fd is emptied. if it were cleared first, a notification between the two would write,
+  // the read would take it, and `pending` would stay set with nothing to read, so that no later notification
+  // wrote again. a notification skipped before this is synchronized by the exchange, and seen by the caller's
+  // check after this returns.
+  pending.exchange(false);
+}
@@ -0,0 +1,28 @@
+#ifndef __HEADER_NOTIFIER__
+#define __HEADER_NOTIFIER__
+
+#include <atomic>
+
+// a file descriptor which other threads make readable to wake up a thread waiting in poll().
+// it is an eventfd on Linux, and a self-pipe elsewhere, e.g. on MSYS2.
+class Notifier {
+  int fds[2];
+  // set between a notification and the next drain(), so that only the first one makes a system call.
+  std::atomic<bool> pending{false};
+
+public:
+  Notifier();
+  Notifier(Notifier const&) = delete;
+  Notifier& operator=(Notifier const&) = delete;
+  ~Notifier();
+
+  // the end to be watched for POLLIN.
+  int fd() const noexcept { return fds[0]; }
+
+  // makes `fd()` readable. never blocks, and notifications not drained yet are coalesced.
+  void notify() noexcept;
+  // makes `fd()` unreadable again. anything notified for has to be checked after this returns.
+  void drain() noexcept;
+};
+
+#endif
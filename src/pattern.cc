@@ -0,0 +1,718 @@
+#include "pattern.hh"
+#include "search.hh"
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using ByteSet = std::bitset<256>;
+
+// thrown by the parser on anything it does not handle, which is then left to std::regex.
+struct Unsupported {
+};
+
+struct Node {
+  enum Kind { Empty, Bytes, Begin, End, Concat, Alt, Repeat };
+
+  Kind kind;
+  ByteSet bytes;
+  std::vector<Node> children;
+  int min = 0, max = 0; // `max < 0` means unbounded.
+
+  Node(Kind kind) : kind{kind} {}
+  Node(ByteSet const& bytes) : kind{Bytes}, bytes{bytes} {}
+};
+
+// bounds of counted repetitions and nesting, beyond which std::regex is used instead.
+constexpr int max_repeat = 1000;
+constexpr int max_depth = 100;
+constexpr std::size_t max_insts = 10000;
+
+ByteSet byte_range(unsigned char lo, unsigned char hi)
+{
+  ByteSet set;
+  for (unsigned c = lo; c <= hi; ++c) {
+    set.set(c);
+  }
+  return set;
+}
+
+ByteSet single_byte(unsigned char c) { return byte_range(c, c); }
+
+int hex_value(char c)
+{
+  if ('0' <= c && c <= '9')
+    return c - '0';
+  if ('a' <= c && c <= 'f')
+    return c - 'a' + 10;
+  if ('A' <= c && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+// a recursive descent parser for the subset of ECMAScript syntax which the automaton can express.
+class Parser {
+  std::string_view s;
+  std::size_t pos = 0;
+  int depth = 0;
+
+public:
+  explicit Parser(std::string_view s) : s{s} {}
+
+  Node parse()
+  {
+    Node node = alternation();
+    if (pos != s.size()) {
+      throw Unsupported{};
+    }
+    return node;
+  }
+
+private:
+  bool at(char c) const { return pos < s.size() && s[pos] == c; }
+  bool at_quantifier() const { return at('*') || at('+') || at('?') || at('{'); }
+
+  char next()
+  {
+    if (pos == s.size()) {
+      throw Unsupported{};
+    }
+    return s[pos++];
+  }
+
+  Node alternation()
+  {
+    Node first = concat();
+    if (!at('|')) {
+      return first;
+    }
+    Node alt{Node::Alt};
+    alt.children.push_back(std::move(first));
+    while (at('|')) {
+      ++pos;
+      alt.children.push_back(concat());
+    }
+    return alt;
+  }
+
+  Node concat()
+  {
+    Node cat{Node::Concat};
+    while (pos < s.size() && !at('|') && !at(')')) {
+      Node node = atom();
+      if (at_quantifier()) {
+        if (node.kind == Node::Begin || node.kind == Node::End) {
+          throw Unsupported{};
+        }
+        node = quantified(std::move(node));
+      }
+      cat.children.push_back(std::move(node));
+    }
+    return cat;
+  }
+
+  Node quantified(Node node)
+  {
+    Node rep{Node::Repeat};
+    switch (next()) {
+    case '*':
+      rep.min = 0, rep.max = -1;
+      break;
+    case '+':
+      rep.min = 1, rep.max = -1;
+      break;
+    case '?':
+      rep.min = 0, rep.max = 1;
+      break;
+    default:
+      rep.min = number();
+      rep.max = rep.min;
+      if (at(',')) {
+        ++pos;
+        rep.max = at('}') ? -1 : number();
+      }
+      if (next() != '}' || (rep.max >= 0 && rep.max < rep.min)) {
+        throw Unsupported{};
+      }
+    }
+    // laziness does not matter to whether a line matches.
+    if (at('?')) {
+      ++pos;
+    }
+    if (at_quantifier()) {
+      throw Unsupported{};
+    }
+    rep.children.push_back(std::move(node));
+    return rep;
+  }
+
+  int number()
+  {
+    int n = 0;
+    std::size_t first = pos;
+    for (; pos < s.size() && '0' <= s[pos] && s[pos] <= '9'; ++pos) {
+      n = n * 10 + (s[pos] - '0');
+      if (n > max_repeat) {
+        throw Unsupported{};
+      }
+    }
+    if (pos == first) {
+      throw Unsupported{};
+    }
+    return n;
+  }
+
+  Node atom()
+  {
+    char c = next();
+    switch (c) {
+    case '(': {
+      if (at('?')) {
+        ++pos;
+        if (next() != ':') {
+          throw Unsupported{};
+        }
+      }
+      if (++depth > max_depth) {
+        throw Unsupported{};
+      }
+      Node node = alternation();
+      if (next() != ')') {
+        throw Unsupported{};
+      }
+      --depth;
+      return node;
+    }
+    case '[':
+      return Node{bracket()};
+    case '.':
+      return Node{~(single_byte('\n') | single_byte('\r'))};
+    case '^':
+      return Node{Node::Begin};
+    case '$':
+      return Node{Node::End};
+    case '\\':
+      return Node{escape()};
+    case '*':
+    case '+':
+    case '?':
+    case '{':
+    case '}':
+    case ']':
+      throw Unsupported{};
+    default:
+      return Node{single_byte(c)};
+    }
+  }
+
+  // the set of bytes denoted by the escape sequence after a backslash.
+  ByteSet escape()
+  {
+    char c = next();
+    switch (c) {
+    case 'd':
+      return byte_range('0', '9');
+    case 'D':
+      return ~byte_range('0', '9');
+    case 'w':
+      return word_bytes();
+    case 'W':
+      return ~word_bytes();
+    case 's':
+      return space_bytes();
+    case 'S':
+      return ~space_bytes();
+    case 't':
+      return single_byte('\t');
+    case 'n':
+      return single_byte('\n');
+    case 'r':
+      return single_byte('\r');
+    case 'f':
+      return single_byte('\f');
+    case 'v':
+      return single_byte('\v');
+    case 'x': {
+      int hi = hex_value(next()), lo = hex_value(next());
+      if (hi < 0 || lo < 0) {
+        throw Unsupported{};
+      }
+      return single_byte(hi * 16 + lo);
+    }
+    default:
+      // identity escapes of punctuations. anything else (\b, \1, \u...) is up to std::regex.
+      if ((c & 0x80) != 0 || std::isalnum(static_cast<unsigned char>(c))) {
+        throw Unsupported{};
+      }
+      return single_byte(c);
+    }
+  }
+
+  static ByteSet word_bytes()
+  {
+    return byte_range('a', 'z') | byte_range('A', 'Z') | byte_range('0', '9') | single_byte('_');
+  }
+  static ByteSet space_bytes() { return byte_range('\t', '\r') | single_byte(' '); }
+
+  // a bracket expression, after the opening '['.
+  ByteSet bracket()
+  {
+    bool negate = at('^');
+    if (negate) {
+      ++pos;
+    }
+    if (at(']')) {
+      throw Unsupported{};
+    }
+
+    ByteSet set;
+    while (!at(']')) {
+      if (at('[')) {
+        throw Unsupported{};
+      }
+      char c = next();
+      ByteSet item = c == '\\' ? escape() : single_byte(c);
+      if (at('-') && pos + 1 < s.size() && s[pos + 1] != ']') {
+        // both ends of a range must be single ASCII characters.
+        ++pos;
+        char d = next();
+        ByteSet last = d == '\\' ? escape() : single_byte(d);
+        int lo = lowest(item), hi = lowest(last);
+        if (d == '[' || item.count() != 1 || last.count() != 1 || lo >= 0x80 || hi >= 0x80 || lo > hi) {
+          throw Unsupported{};
+        }
+        item = byte_range(lo, hi);
+      }
+      set |= item;
+    }
+    ++pos;
+    return negate ? ~set : set;
+  }
+
+  static int lowest(ByteSet const& set)
+  {
+    for (int c = 0; c < 256; ++c) {
+      if (set[c])
+        return c;
+    }
+    return 256;
+  }
+};
+
+// what a node tells about literals in matched strings.
+struct Literals {
+  bool exact;           // the node matches `str` only.
+  std::string str;
+  std::string required; // a string contained in every match.
+};
+
+// exact strings longer than this are not tracked.
+constexpr std::size_t max_literal = 256;
+
+void keep_longer(std::string& dst, std::string const& src)
+{
+  if (src.size() > dst.size()) {
+    dst = src;
+  }
+}
+
+Literals literals_of(Node const& node)
+{
+  switch (node.kind) {
+  case Node::Empty:
+    return {true, "", ""};
+  case Node::Bytes:
+    if (node.bytes.count() == 1) {
+      for (int c = 0; c < 256; ++c) {
+        if (node.bytes[c]) {
+          std::string str(1, static_cast<char>(c));
+          return {true, str, str};
+        }
+      }
+    }
+    return {false, "", ""};
+  case Node::Concat: {
+    Literals result{true, "", ""};
+    std::string run;
+    for (auto& child : node.children) {
+      auto lit = literals_of(child);
+      if (lit.exact && run.size() + lit.str.size() <= max_literal) {
+        run += lit.str;
+        continue;
+      }
+      keep_longer(result.required, run);
+      keep_longer(result.required, lit.exact ? lit.str : lit.required);
+      run.clear();
+      result.exact = false;
+    }
+    keep_longer(result.required, run);
+    if (result.exact) {
+      result.str = run;
+    }
+    return result;
+  }
+  case Node::Alt:
+    if (node.children.size() == 1) {
+      return literals_of(node.children[0]);
+    }
+    return {false, "", ""};
+  case Node::Repeat: {
+    if (node.min == 0) {
+      return {false, "", ""};
+    }
+    auto lit = literals_of(node.children[0]);
+    if (lit.exact && node.min == node.max && lit.str.size() * node.min <= max_literal) {
+      std::string str;
+      for (int i = 0; i < node.min; ++i) {
+        str += lit.str;
+      }
+      return {true, str, str};
+    }
+    return {false, "", lit.exact ? lit.str : lit.required};
+  }
+  default:
+    // anchors.
+    return {false, "", ""};
+  }
+}
+
+struct Inst {
+  enum Op : std::uint8_t { Byte, Split, Begin, End, Match };
+
+  Op op;
+  std::uint32_t x = 0; // the next instruction, or the index of the byte set for `Byte`.
+  std::uint32_t y = 0; // the other branch of `Split`, or the next instruction for `Byte`.
+};
+
+} // namespace
+
+struct Pattern::Program {
+  std::vector<Inst> insts;
+  std::vector<ByteSet> sets;
+  std::uint32_t start = 0;
+
+  // bytes which no instruction distinguishes share a class, and the DFA has a transition per class.
+  std::array<std::uint8_t, 256> classes;
+  std::vector<unsigned char> representatives;
+
+  explicit Program(Node const& root);
+
+private:
+  std::uint32_t emit(Inst inst);
+  std::uint32_t compile(Node const& node, std::uint32_t next);
+};
+
+Pattern::Program::Program(Node const& root)
+{
+  std::uint32_t match = emit(Inst{Inst::Match});
+  start = compile(root, match);
+
+  ByteSet boundaries;
+  for (auto& set : sets) {
+    for (int c = 1; c < 256; ++c) {
+      if (set[c] != set[c - 1]) {
+        boundaries.set(c);
+      }
+    }
+  }
+  representatives.push_back(0);
+  for (int c = 0; c < 256; ++c) {
+    if (boundaries[c]) {
+      representatives.push_back(c);
+    }
+    classes[c] = representatives.size() - 1;
+  }
+}
+
+std::uint32_t Pattern::Program::emit(Inst inst)
+{
+  if (insts.size() >= max_insts) {
+    throw Unsupported{};
+  }
+  insts.push_back(inst);
+  return insts.size() - 1;
+}
+
+// compiles `node` backwards, so that the code continues to `next`. returns the entry point.
+std::uint32_t Pattern::Program::compile(Node const& node, std::uint32_t next)
+{
+  switch (node.kind) {
+  case Node::Empty:
+    return next;
+  case Node::Bytes:
+    sets.push_back(node.bytes);
+    return emit(Inst{Inst::Byte, static_cast<std::uint32_t>(sets.size() - 1), next});
+  case Node::Begin:
+    return emit(Inst{Inst::Begin, next});
+  case Node::End:
+    return emit(Inst{Inst::End, next});
+  case Node::Concat:
+    for (auto it = node.children.rbegin(); it != node.children.rend(); ++it) {
+      next = compile(*it, next);
+    }
+    return next;
+  case Node::Alt: {
+    std::uint32_t entry = compile(node.children.back(), next);
+    for (std::size_t i = node.children.size() - 1; i-- > 0;) {
+      std::uint32_t branch = compile(node.children[i], next);
+      entry = emit(Inst{Inst::Split, branch, entry});
+    }
+    return entry;
+  }
+  case Node::Repeat: {
+    auto& child = node.children[0];
+    std::uint32_t entry = next;
+    if (node.max < 0) {
+      std::uint32_t loop = emit(Inst{Inst::Split});
+      std::uint32_t body = compile(child, loop);
+      insts[loop].x = body;
+      insts[loop].y = next;
+      entry = loop;
+    }
+    else {
+      for (int i = node.min; i < node.max; ++i) {
+        entry = emit(Inst{Inst::Split, compile(child, entry), next});
+      }
+    }
+    for (int i = 0; i < node.min; ++i) {
+      entry = compile(child, entry);
+    }
+    return entry;
+  }
+  }
+  throw Unsupported{};
+}
+
+namespace {
+
+// a DFA built from a program on demand, while searching.
+// each state is the set of NFA instructions the search may be at, and is created when first reached.
+class Dfa {
+  enum Flag : std::uint8_t { Matched = 1, Dead = 2, MatchAtEnd = 4 };
+
+  std::shared_ptr<Pattern::Program const> program;
+  std::size_t num_classes;
+  std::size_t max_states;
+
+  std::vector<std::vector<std::uint32_t>> states;
+  std::vector<std::uint8_t> flags;
+  std::vector<std::int32_t> table; // states.size() * num_classes transitions, or -1 if not computed yet.
+  std::unordered_map<std::string, std::int32_t> ids;
+  std::int32_t start = -1;
+
+  // scratch space for epsilon closures.
+  std::vector<std::uint32_t> marks;
+  std::uint32_t generation = 0;
+  std::vector<std::uint32_t> stack;
+
+public:
+  explicit Dfa(std::shared_ptr<Pattern::Program const> program)
+      : program{std::move(program)}, marks(this->program->insts.size(), 0)
+  {
+    num_classes = this->program->representatives.size();
+    // the transition table of a DFA is limited to about 2MiB, and is flushed when it gets full.
+    max_states = std::max<std::size_t>(64, (1 << 21) / (num_classes * sizeof(std::int32_t)));
+  }
+
+  Pattern::Program const* get() const noexcept { return program.get(); }
+
+  bool search(std::string_view text)
+  {
+    if (start < 0) {
+      start = intern(closure_from({program->start}, true), true);
+    }
+    std::int32_t s = start;
+    for (unsigned char c : text) {
+      if (flags[s] & (Matched | Dead)) {
+        break;
+      }
+      std::size_t cls = program->classes[c];
+      std::int32_t t = table[s * num_classes + cls];
+      s = t >= 0 ? t : step(s, cls);
+    }
+    return (flags[s] & (Matched | MatchAtEnd)) != 0;
+  }
+
+private:
+  // the sorted set of instructions reachable from `pcs` without consuming a byte.
+  // `End` instructions stay in the set, since whether they pass is known only at the end.
+  std::vector<std::uint32_t> closure_from(std::vector<std::uint32_t> const& pcs, bool at_begin, bool at_end = false)
+  {
+    std::vector<std::uint32_t> result;
+    ++generation;
+    stack.assign(pcs.rbegin(), pcs.rend());
+    while (!stack.empty()) {
+      std::uint32_t pc = stack.back();
+      stack.pop_back();
+      if (marks[pc] == generation) {
+        continue;
+      }
+      marks[pc] = generation;
+
+      auto& inst = program->insts[pc];
+      switch (inst.op) {
+      case Inst::Byte:
+      case Inst::Match:
+        result.push_back(pc);
+        break;
+      case Inst::Split:
+        stack.push_back(inst.y);
+        stack.push_back(inst.x);
+        break;
+      case Inst::Begin:
+        if (at_begin) {
+          stack.push_back(inst.x);
+        }
+        break;
+      case Inst::End:
+        if (at_end) {
+          stack.push_back(inst.x);
+        }
+        else {
+          result.push_back(pc);
+        }
+        break;
+      }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+  }
+
+  std::int32_t step(std::int32_t s, std::size_t cls)
+  {
+    unsigned char c = program->representatives[cls];
+    std::vector<std::uint32_t> targets;
+    for (auto pc : states[s]) {
+      auto& inst = program->insts[pc];
+      if (inst.op == Inst::Byte && program->sets[inst.x][c]) {
+        targets.push_back(inst.y);
+      }
+    }
+    // a match may also start at the next position.
+    targets.push_back(program->start);
+    auto next = closure_from(targets, false);
+
+    if (states.size() >= max_states && ids.find(key_of(next)) == ids.end()) {
+      auto current = std::move(states[s]);
+      flush();
+      s = intern(std::move(current));
+    }
+    std::int32_t t = intern(std::move(next));
+    table[s * num_classes + cls] = t;
+    return t;
+  }
+
+  // the start state is told apart from others with the same instructions, as `^` may pass there.
+  static std::string key_of(std::vector<std::uint32_t> const& pcs, bool at_begin = false)
+  {
+    std::string key(1 + pcs.size() * sizeof(std::uint32_t), at_begin ? 'B' : '-');
+    std::memcpy(&key[1], pcs.data(), pcs.size() * sizeof(std::uint32_t));
+    return key;
+  }
+
+  std::int32_t intern(std::vector<std::uint32_t> pcs, bool at_begin = false)
+  {
+    auto key = key_of(pcs, at_begin);
+    auto found = ids.find(key);
+    if (found != ids.end()) {
+      return found->second;
+    }
+
+    std::uint8_t flag = pcs.empty() ? Dead : 0;
+    std::vector<std::uint32_t> ends;
+    for (auto pc : pcs) {
+      auto op = program->insts[pc].op;
+      if (op == Inst::Match) {
+        flag |= Matched;
+      }
+      else if (op == Inst::End) {
+        ends.push_back(program->insts[pc].x);
+      }
+    }
+    if (!ends.empty()) {
+      auto at_end = closure_from(ends, at_begin, true);
+      auto is_match = [&](auto pc) { return program->insts[pc].op == Inst::Match; };
+      if (std::any_of(at_end.begin(), at_end.end(), is_match)) {
+        flag |= MatchAtEnd;
+      }
+    }
+
+    std::int32_t id = states.size();
+    states.push_back(std::move(pcs));
+    flags.push_back(flag);
+    table.resize(states.size() * num_classes, -1);
+    ids.emplace(std::move(key), id);
+    return id;
+  }
+
+  void flush()
+  {
+    states.clear();
+    flags.clear();
+    table.clear();
+    ids.clear();
+    start = -1;
+  }
+};
+
+// DFAs are built while searching, so every thread has its own ones.
+// a few of them are kept so that switching back to a recent pattern does not start from scratch.
+constexpr std::size_t dfa_cache_size = 4;
+
+Dfa& dfa_for(std::shared_ptr<Pattern::Program const> const& program)
+{
+  thread_local std::vector<std::unique_ptr<Dfa>> cache;
+
+  auto found = std::find_if(cache.begin(), cache.end(), [&](auto& dfa) { return dfa->get() == program.get(); });
+  if (found != cache.end()) {
+    std::rotate(cache.begin(), found, found + 1);
+  }
+  else {
+    if (cache.size() >= dfa_cache_size) {
+      cache.pop_back();
+    }
+    cache.insert(cache.begin(), std::make_unique<Dfa>(program));
+  }
+  return *cache.front();
+}
+
+} // namespace
+
+Pattern::Pattern(std::string const& source)
+{
+  try {
+    Node root = Parser{source}.parse();
+    auto lit = literals_of(root);
+    literal = lit.exact ? lit.str : lit.required;
+    literal_only = lit.exact;
+    if (!literal_only) {
+      program = std::make_shared<Program const>(root);
+    }
+  }
+  catch (Unsupported&) {
+    literal.clear();
+    literal_only = false;
+    fallback.emplace(source);
+  }
+}
+
+bool Pattern::search(std::string_view text) const
+{
+  if (!literal.empty() && !contains(text, literal)) {
+    return false;
+  }
+  if (literal_only) {
+    return true;
+  }
+  if (fallback) {
+    return std::regex_search(text.begin(), text.end(), *fallback);
+  }
+  return dfa_for(program).search(text);
+}
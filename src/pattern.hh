@@ -0,0 +1,40 @@
+#ifndef __HEADER_PATTERN__
+#define __HEADER_PATTERN__
+
+#include <memory>
+#include <optional>
+#include <regex>
+#include <string>
+#include <string_view>
+
+// a regular expression in ECMAScript syntax, matched against the bytes of a line.
+//
+// patterns are compiled into a Thompson NFA and searched with a DFA built lazily from it,
+// so the time taken is linear in the length of the line whatever the pattern is.
+// the longest literal which every match has to contain is looked up with find_substring() first.
+// features the automaton cannot express (back-references, word boundaries, lookahead and so on)
+// are left to std::regex.
+class Pattern {
+public:
+  struct Program;
+
+private:
+  std::shared_ptr<Program const> program;
+  std::optional<std::regex> fallback;
+  std::string literal;
+  bool literal_only = false;
+
+public:
+  // throws std::regex_error if `source` is not a valid pattern.
+  explicit Pattern(std::string const& source);
+
+  // returns true if a substring of `text` matches.
+  bool search(std::string_view text) const;
+
+  // whether the pattern is searched by the automaton rather than std::regex.
+  bool is_linear() const noexcept { return !fallback; }
+  // the literal every matched line contains, or an empty string if there is none.
+  std::string const& required_literal() const noexcept { return literal; }
+};
+
+#endif
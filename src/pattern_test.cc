@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <regex>
+#include <string>
+#include "pattern.hh"
+
+TEST(pattern_test, search)
+{
+  EXPECT_TRUE(Pattern{"b+c"}.search("abbbcd"));
+  EXPECT_FALSE(Pattern{"b+c"}.search("acd"));
+  EXPECT_TRUE(Pattern{"^ab|cd$"}.search("xxcd"));
+  EXPECT_FALSE(Pattern{"^ab|cd$"}.search("xabcdx"));
+  EXPECT_TRUE(Pattern{"[a-c]{2,3}x"}.search("zzbcx"));
+  EXPECT_FALSE(Pattern{"[^a-c]{2}x"}.search("zbx"));
+  EXPECT_TRUE(Pattern{R"(\d+\.\d*)"}.search("v1.2"));
+  EXPECT_TRUE(Pattern{"^$"}.search(""));
+  EXPECT_TRUE(Pattern{"(?:ab)*c"}.search("c"));
+  EXPECT_TRUE(Pattern{u8"ほ.*げ"}.search(u8"ほほげ"));
+}
+
+TEST(pattern_test, required_literal)
+{
+  EXPECT_EQ("foo", Pattern{"foo"}.required_literal());
+  EXPECT_EQ("error: ", Pattern{"^.*error: [0-9]+"}.required_literal());
+  EXPECT_EQ("abab", Pattern{"x?(ab){2}"}.required_literal());
+  EXPECT_EQ("", Pattern{"foo|bar"}.required_literal());
+}
+
+TEST(pattern_test, fallback)
+{
+  Pattern backref{R"((a)\1)"};
+  EXPECT_FALSE(backref.is_linear());
+  EXPECT_TRUE(backref.search("xaa"));
+  EXPECT_FALSE(backref.search("xab"));
+
+  EXPECT_TRUE(Pattern{"a.c"}.is_linear());
+  EXPECT_THROW(Pattern{"(a"}, std::regex_error);
+  EXPECT_THROW(Pattern{"[b-a]"}, std::regex_error);
+}
+
+TEST(pattern_test, linear_time)
+{
+  // exponential for backtracking engines.
+  Pattern p{"(a|aa)*(a|aa)*(a|aa)*b"};
+  ASSERT_TRUE(p.is_linear());
+  EXPECT_FALSE(p.search(std::string(10000, 'a')));
+}
+
+TEST(pattern_test, same_as_std_regex)
+{
+  std::mt19937 rng(2016);
+  std::string const atoms[] = {"a", "b", ".", "[ab]", "[^a]", "\\d", "\\w", "^", "$", "(a|b)", "(?:ab)", "x"};
+  std::string const quantifiers[] = {"", "", "", "*", "+", "?", "{2}", "{1,2}", "{0,}"};
+
+  for (int iter = 0; iter < 3000; ++iter) {
+    std::string source;
+    for (int n = 1 + rng() % 4; n > 0; --n) {
+      std::string atom = atoms[rng() % 12];
+      source += atom;
+      if (atom != "^" && atom != "$") {
+        source += quantifiers[rng() % 9];
+      }
+      if (rng() % 5 == 0) {
+        source += "|";
+      }
+    }
+    std::regex re{source};
+    Pattern pattern{source};
+
+    for (int k = 0; k < 20; ++k) {
+      std::string text(rng() % 8, ' ');
+      for (auto& c : text) {
+        c = "ab1x "[rng() % 5];
+      }
+      ASSERT_EQ(std::regex_search(text, re), pattern.search(text)) << source << " / " << text;
+    }
+  }
+}
@@ -0,0 +1,87 @@
+#include "result_cache.hh"
+
+#include <algorithm>
+
+std::size_t ResultCache::Entry::memory_usage() const noexcept
+{
+  return sizeof(Entry) + query.size() + indices.size() * sizeof(std::uint32_t) + scores.size() * sizeof(float) +
+         bits.size() * sizeof(std::uint64_t);
+}
+
+bool ResultCache::get(FilterMode mode, std::string const& query, std::vector<Choice>& choices, std::size_t& covered,
+                      bool& ranked)
+{
+  auto found = std::find_if(entries.begin(), entries.end(),
+                            [&](Entry const& entry) { return entry.mode == mode && entry.query == query; });
+  if (found == entries.end()) {
+    return false;
+  }
+  entries.splice(entries.begin(), entries, found);
+
+  Entry const& entry = entries.front();
+  choices.clear();
+  if (!entry.bits.empty()) {
+    for (std::size_t w = 0; w < entry.bits.size(); ++w) {
+      for (std::uint64_t word = entry.bits[w]; word != 0; word &= word - 1) {
+        choices.emplace_back(w * 64 + __builtin_ctzll(word));
+      }
+    }
+  }
+  else {
+    choices.assign(entry.indices.begin(), entry.indices.end());
+  }
+  // unranked filters score every match 1.
+  for (std::size_t i = 0; i < choices.size(); ++i) {
+    choices[i].score = entry.ranked ? entry.scores[i] : 1.0f;
+  }
+  covered = entry.covered;
+  ranked = entry.ranked;
+  return true;
+}
+
+void ResultCache::put(FilterMode mode, std::string const& query, std::vector<Choice> const& choices,
+                      std::size_t covered, bool ranked)
+{
+  auto found = std::find_if(entries.begin(), entries.end(),
+                            [&](Entry const& entry) { return entry.mode == mode && entry.query == query; });
+  if (found != entries.end()) {
+    memory -= found->memory_usage();
+    entries.erase(found);
+  }
+
+  Entry entry{mode, query, covered, ranked, {}, {}, {}};
+  // estimated before the result is copied, so that a large one is not copied in vain.
+  std::size_t const bitmap_size = (covered + 63) / 64 * sizeof(std::uint64_t);
+  bool const use_bitmap = !ranked && bitmap_size < choices.size() * sizeof(std::uint32_t);
+  std::size_t const size = sizeof(Entry) + query.size() +
+                           (use_bitmap ? bitmap_size : choices.size() * (ranked ? 8 : 4));
+  if (size > memory_limit) {
+    return;
+  }
+
+  if (use_bitmap) {
+    entry.bits.resize((covered + 63) / 64);
+    for (auto& choice : choices) {
+      entry.bits[choice.index / 64] |= std::uint64_t{1} << (choice.index % 64);
+    }
+  }
+  else {
+    entry.indices.resize(choices.size());
+    for (std::size_t i = 0; i < choices.size(); ++i) {
+      entry.indices[i] = choices[i].index;
+    }
+    if (ranked) {
+      entry.scores.resize(choices.size());
+      for (std::size_t i = 0; i < choices.size(); ++i) {
+        entry.scores[i] = choices[i].score;
+      }
+    }
+  }
+
+  memory += entry.memory_usage();
+  entries.push_front(std::move(entry));
+  while (memory > memory_limit) {
+    memory -= entries.back().memory_usage();
+    entries.pop_back();
+  }
+}
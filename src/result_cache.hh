@@ -0,0 +1,51 @@
+#ifndef __HEADER_RESULT_CACHE__
+#define __HEADER_RESULT_CACHE__
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <vector>
+#include "choice.hh"
+#include "filter.hh"
+
+// the results of recent queries, so that going back to one (e.g. by a backspace or rotating the mode)
+// does not score the lines again.
+//
+// a result covers the lines filtered so far. as lines are only appended, it stays valid for them, and only the
+// lines after them need to be filtered when it is reused.
+// results are kept compactly within a memory limit, and the least recently used ones are dropped first:
+// matches of ranked filters with their scores, and the others as line numbers or a bitmap, whichever is smaller.
+class ResultCache {
+  struct Entry {
+    FilterMode mode;
+    std::string query;
+    std::size_t covered;
+    bool ranked;
+    std::vector<std::uint32_t> indices;
+    std::vector<float> scores;       // only for ranked filters.
+    std::vector<std::uint64_t> bits; // instead of `indices` if they are many.
+
+    std::size_t memory_usage() const noexcept;
+  };
+
+  std::list<Entry> entries; // the most recently used first.
+  std::size_t memory = 0;
+  std::size_t memory_limit;
+
+public:
+  explicit ResultCache(std::size_t memory_limit) : memory_limit{memory_limit} {}
+
+  // puts the matches of (`mode`, `query`) among the first `covered` lines into `choices` in input order.
+  // returns false if they are not cached.
+  bool get(FilterMode mode, std::string const& query, std::vector<Choice>& choices, std::size_t& covered,
+           bool& ranked);
+  // `choices` are in input order. a result which does not fit in the memory limit is not kept.
+  void put(FilterMode mode, std::string const& query, std::vector<Choice> const& choices, std::size_t covered,
+           bool ranked);
+
+  std::size_t size() const noexcept { return entries.size(); }
+  std::size_t memory_usage() const noexcept { return memory; }
+};
+
+#endif
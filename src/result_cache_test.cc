@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+
+#include "result_cache.hh"
+
+static std::vector<Choice> make_choices(std::vector<std::size_t> const& indices, float score)
+{
+  std::vector<Choice> choices;
+  for (auto i : indices) {
+    choices.emplace_back(i);
+    choices.back().score = score;
+  }
+  return choices;
+}
+
+static void expect_cached(ResultCache& cache, FilterMode mode, std::string const& query,
+                          std::vector<Choice> const& expected, std::size_t expected_covered, bool expected_ranked)
+{
+  std::vector<Choice> choices;
+  std::size_t covered = 0;
+  bool ranked = !expected_ranked;
+  ASSERT_TRUE(cache.get(mode, query, choices, covered, ranked)) << query;
+  EXPECT_EQ(expected_covered, covered);
+  EXPECT_EQ(expected_ranked, ranked);
+  ASSERT_EQ(expected.size(), choices.size());
+  for (std::size_t i = 0; i < choices.size(); ++i) {
+    EXPECT_EQ(expected[i].index, choices[i].index);
+    EXPECT_EQ(expected[i].score, choices[i].score);
+  }
+}
+
+TEST(result_cache_test, round_trip)
+{
+  ResultCache cache{1 << 20};
+  std::vector<Choice> choices;
+  std::size_t covered;
+  bool ranked;
+  EXPECT_FALSE(cache.get(FilterMode::Fuzzy, "a", choices, covered, ranked));
+
+  auto fuzzy = make_choices({3, 5, 8}, 0.5f);
+  fuzzy[1].score = 0.25f;
+  cache.put(FilterMode::Fuzzy, "a", fuzzy, 10, true);
+  // sparse matches are kept as line numbers, and dense ones as a bitmap.
+  auto sparse = make_choices({1, 4000}, 1.0f);
+  cache.put(FilterMode::CaseSensitive, "a", sparse, 5000, false);
+  std::vector<std::size_t> all;
+  for (std::size_t i = 0; i < 5000; i += 3) {
+    all.push_back(i);
+  }
+  auto dense = make_choices(all, 1.0f);
+  cache.put(FilterMode::SmartCase, "a", dense, 5000, false);
+  EXPECT_EQ(3, cache.size());
+
+  expect_cached(cache, FilterMode::Fuzzy, "a", fuzzy, 10, true);
+  expect_cached(cache, FilterMode::CaseSensitive, "a", sparse, 5000, false);
+  expect_cached(cache, FilterMode::SmartCase, "a", dense, 5000, false);
+  EXPECT_FALSE(cache.get(FilterMode::Regex, "a", choices, covered, ranked));
+
+  // a query filtered again replaces its result.
+  cache.put(FilterMode::Fuzzy, "a", make_choices({3}, 1.0f), 20, true);
+  expect_cached(cache, FilterMode::Fuzzy, "a", make_choices({3}, 1.0f), 20, true);
+  EXPECT_EQ(3, cache.size());
+}
+
+TEST(result_cache_test, memory_limit)
+{
+  std::vector<std::size_t> indices(1000);
+  for (std::size_t i = 0; i < indices.size(); ++i) {
+    indices[i] = i * 100;
+  }
+  auto choices = make_choices(indices, 1.0f);
+
+  // each result takes about 4000 bytes.
+  ResultCache cache{10000};
+  cache.put(FilterMode::CaseSensitive, "a", choices, 100000, false);
+  cache.put(FilterMode::CaseSensitive, "b", choices, 100000, false);
+  std::vector<Choice> out;
+  std::size_t covered;
+  bool ranked;
+  EXPECT_TRUE(cache.get(FilterMode::CaseSensitive, "a", out, covered, ranked));
+
+  // the least recently used one is dropped.
+  cache.put(FilterMode::CaseSensitive, "c", choices, 100000, false);
+  EXPECT_EQ(2, cache.size());
+  EXPECT_LE(cache.memory_usage(), 10000);
+  EXPECT_TRUE(cache.get(FilterMode::CaseSensitive, "a", out, covered, ranked));
+  EXPECT_FALSE(cache.get(FilterMode::CaseSensitive, "b", out, covered, ranked));
+
+  // a result larger than the limit is not kept.
+  indices.resize(2000);
+  cache.put(FilterMode::Fuzzy, "d", make_choices(indices, 0.5f), 100000, true);
+  EXPECT_FALSE(cache.get(FilterMode::Fuzzy, "d", out, covered, ranked));
+  EXPECT_EQ(2, cache.size());
+
+  ResultCache disabled{0};
+  disabled.put(FilterMode::CaseSensitive, "a", choices, 100000, false);
+  EXPECT_EQ(0, disabled.size());
+}
@@ -0,0 +1,226 @@
+#include "search.hh"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define COCO_SEARCH_X86 1
+#endif
+
+namespace {
+
+constexpr std::size_t npos = std::string_view::npos;
+
+using find_fn = std::size_t (*)(char const*, std::size_t, char const*, std::size_t);
+
+// `needle` is already lower-cased when `ICase` is set.
+template <bool ICase>
+bool equal_at(char const* s, char const* needle, std::size_t m)
+{
+  if (!ICase) {
+    return std::memcmp(s, needle, m) == 0;
+  }
+  for (std::size_t k = 0; k < m; ++k) {
+    if (fold_ascii(s[k]) != needle[k]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <bool ICase>
+std::size_t find_scalar(char const* s, std::size_t n, char const* needle, std::size_t m, std::size_t from)
+{
+  if (!ICase) {
+    return std::string_view{s, n}.find(std::string_view{needle, m}, from);
+  }
+  for (std::size_t i = from; i + m <= n; ++i) {
+    if (fold_ascii(s[i]) == needle[0] && equal_at<true>(s + i + 1, needle + 1, m - 1)) {
+      return i;
+    }
+  }
+  return npos;
+}
+
+#ifdef COCO_SEARCH_X86
+
+// verifies the candidate positions `i + bit` for each bit set in `mask`.
+// the first and the last byte have already been compared.
+template <bool ICase>
+inline std::size_t verify(char const* s, std::size_t i, unsigned mask, char const* needle, std::size_t m)
+{
+  while (mask != 0) {
+    unsigned bit = __builtin_ctz(mask);
+    if (m <= 2 || equal_at<ICase>(s + i + bit + 1, needle + 1, m - 2)) {
+      return i + bit;
+    }
+    mask &= mask - 1;
+  }
+  return npos;
+}
+
+// a byte of the block is folded as `byte | 0x20` if the needle has a letter at that place,
+// which maps exactly 'A' and 'a' to 'a'. other bytes are compared as they are.
+inline char fold_bit(char c) { return ('a' <= c && c <= 'z') ? 0x20 : 0; }
+
+// compares the first and the last byte of the needle at every position of a block at once,
+// and verifies only the positions where both of them match.
+// see http://0x80.pl/articles/simd-strfind.html
+template <bool ICase>
+std::size_t find_sse2(char const* s, std::size_t n, char const* needle, std::size_t m)
+{
+  if (n < m + 15) {
+    return find_scalar<ICase>(s, n, needle, m, 0);
+  }
+
+  __m128i const first = _mm_set1_epi8(needle[0]);
+  __m128i const last = _mm_set1_epi8(needle[m - 1]);
+  __m128i const first_bit = _mm_set1_epi8(fold_bit(needle[0]));
+  __m128i const last_bit = _mm_set1_epi8(fold_bit(needle[m - 1]));
+  auto candidates = [&](std::size_t i) {
+    __m128i block_first = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s + i));
+    __m128i block_last = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s + i + m - 1));
+    if (ICase) {
+      block_first = _mm_or_si128(block_first, first_bit);
+      block_last = _mm_or_si128(block_last, last_bit);
+    }
+    __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last));
+    return static_cast<unsigned>(_mm_movemask_epi8(eq));
+  };
+
+  std::size_t i = 0;
+  for (; i + m + 15 <= n; i += 16) {
+    std::size_t pos = verify<ICase>(s, i, candidates(i), needle, m);
+    if (pos != npos) {
+      return pos;
+    }
+  }
+
+  // the last (overlapping) block, without the positions already checked.
+  std::size_t const tail = n - m - 15;
+  if (i - tail < 16) {
+    return verify<ICase>(s, tail, candidates(tail) & (~0u << (i - tail)), needle, m);
+  }
+  return npos;
+}
+
+// lambdas do not inherit the target attribute, so the loop body is spelled out here.
+template <bool ICase>
+__attribute__((target("avx2"))) unsigned candidates_avx2(char const* s, std::size_t i, std::size_t m, __m256i first,
+                                                          __m256i last, __m256i first_bit, __m256i last_bit)
+{
+  __m256i block_first = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(s + i));
+  __m256i block_last = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(s + i + m - 1));
+  if (ICase) {
+    block_first = _mm256_or_si256(block_first, first_bit);
+    block_last = _mm256_or_si256(block_last, last_bit);
+  }
+  __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last));
+  return static_cast<unsigned>(_mm256_movemask_epi8(eq));
+}
+
+template <bool ICase>
+__attribute__((target("avx2"))) std::size_t find_avx2(char const* s, std::size_t n, char const* needle, std::size_t m)
+{
+  if (n < m + 31) {
+    return find_sse2<ICase>(s, n, needle, m);
+  }
+
+  __m256i const first = _mm256_set1_epi8(needle[0]);
+  __m256i const last = _mm256_set1_epi8(needle[m - 1]);
+  __m256i const first_bit = _mm256_set1_epi8(fold_bit(needle[0]));
+  __m256i const last_bit = _mm256_set1_epi8(fold_bit(needle[m - 1]));
+
+  std::size_t i = 0;
+  for (; i + m + 63 <= n; i += 64) {
+    unsigned lo = candidates_avx2<ICase>(s, i, m, first, last, first_bit, last_bit);
+    unsigned hi = candidates_avx2<ICase>(s, i + 32, m, first, last, first_bit, last_bit);
+    if ((lo | hi) == 0) {
+      continue;
+    }
+    std::size_t pos = verify<ICase>(s, i, lo, needle, m);
+    if (pos == npos) {
+      pos = verify<ICase>(s, i + 32, hi, needle, m);
+    }
+    if (pos != npos) {
+      return pos;
+    }
+  }
+  for (; i + m + 31 <= n; i += 32) {
+    unsigned mask = candidates_avx2<ICase>(s, i, m, first, last, first_bit, last_bit);
+    std::size_t pos = verify<ICase>(s, i, mask, needle, m);
+    if (pos != npos) {
+      return pos;
+    }
+  }
+
+  std::size_t const tail = n - m - 31;
+  if (i - tail < 32) {
+    unsigned mask = candidates_avx2<ICase>(s, tail, m, first, last, first_bit, last_bit);
+    return verify<ICase>(s, tail, mask & (~0u << (i - tail)), needle, m);
+  }
+  return npos;
+}
+
+template <bool ICase>
+find_fn select_kernel()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") ? find_avx2<ICase> : find_sse2<ICase>;
+}
+
+#else
+
+template <bool ICase>
+std::size_t find_generic(char const* s, std::size_t n, char const* needle, std::size_t m)
+{
+  return find_scalar<ICase>(s, n, needle, m, 0);
+}
+
+template <bool ICase>
+find_fn select_kernel()
+{
+  return find_generic<ICase>;
+}
+
+#endif
+
+find_fn const kernel = select_kernel<false>();
+find_fn const kernel_icase = select_kernel<true>();
+
+} // namespace
+
+std::size_t find_substring(std::string_view haystack, std::string_view needle)
+{
+  std::size_t const n = haystack.size();
+  std::size_t const m = needle.size();
+
+  if (m == 0) {
+    return 0;
+  }
+  if (m > n) {
+    return npos;
+  }
+  if (m == 1) {
+    auto p = static_cast<char const*>(std::memchr(haystack.data(), needle[0], n));
+    return p == nullptr ? npos : p - haystack.data();
+  }
+  return kernel(haystack.data(), n, needle.data(), m);
+}
+
+std::size_t find_substring_icase(std::string_view haystack, std::string_view needle)
+{
+  std::size_t const n = haystack.size();
+  std::size_t const m = needle.size();
+
+  if (m == 0) {
+    return 0;
+  }
+  if (m > n) {
+    return npos;
+  }
+  if (m == 1 && !('a' <= needle[0] && needle[0] <= 'z')) {
+    return find_substring(haystack, needle);
+  }
+  return kernel_icase(haystack.data(), n, needle.data(), m);
+}
@@ -0,0 +1,40 @@
+#ifndef __HEADER_SEARCH__
+#define __HEADER_SEARCH__
+
+#include <string_view>
+
+// maps ASCII uppercase letters to lowercase, and any other byte to itself.
+struct AsciiFoldTable {
+  char map[256];
+
+  constexpr AsciiFoldTable() : map{}
+  {
+    for (int c = 0; c < 256; ++c) {
+      map[c] = static_cast<char>(('A' <= c && c <= 'Z') ? c + ('a' - 'A') : c);
+    }
+  }
+};
+
+inline constexpr AsciiFoldTable ascii_fold_table{};
+
+inline char fold_ascii(char c) { return ascii_fold_table.map[static_cast<unsigned char>(c)]; }
+
+// returns the position of the first occurrence of `needle` in `haystack`, or std::string_view::npos.
+// uses an SSE2 or AVX2 kernel (selected at runtime) where available.
+std::size_t find_substring(std::string_view haystack, std::string_view needle);
+
+// same as find_substring(), but ASCII letters in `haystack` match regardless of their case.
+// `needle` must be lower-cased with fold_ascii() beforehand.
+std::size_t find_substring_icase(std::string_view haystack, std::string_view needle);
+
+inline bool contains(std::string_view haystack, std::string_view needle)
+{
+  return find_substring(haystack, needle) != std::string_view::npos;
+}
+
+inline bool contains_icase(std::string_view haystack, std::string_view needle)
+{
+  return find_substring_icase(haystack, needle) != std::string_view::npos;
+}
+
+#endif
@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+#include "search.hh"
+
+TEST(search_test, find_substring)
+{
+  EXPECT_EQ(0, find_substring("abc", ""));
+  EXPECT_EQ(std::string_view::npos, find_substring("", "a"));
+  EXPECT_EQ(std::string_view::npos, find_substring("ab", "abc"));
+  EXPECT_EQ(1, find_substring("abc", "b"));
+  EXPECT_EQ(0, find_substring("abc", "abc"));
+  EXPECT_EQ(3, find_substring(u8"ほげ", u8"げ"));
+}
+
+TEST(search_test, find_substring_long)
+{
+  std::string hay(1000, 'a');
+  hay += "needle";
+  hay += std::string(100, 'a');
+
+  EXPECT_EQ(1000, find_substring(hay, "needle"));
+  EXPECT_EQ(1000, find_substring(hay, "ne"));
+  EXPECT_EQ(std::string_view::npos, find_substring(hay, "needles"));
+  EXPECT_EQ(hay.size(), find_substring(hay + "end", "end"));
+}
+
+TEST(search_test, find_substring_random)
+{
+  std::mt19937 rng(12345);
+  for (int iter = 0; iter < 20000; ++iter) {
+    std::string hay(rng() % 300, ' '), needle(1 + rng() % 6, ' ');
+    for (auto& c : hay)
+      c = "abc"[rng() % 3];
+    for (auto& c : needle)
+      c = "abc"[rng() % 3];
+
+    ASSERT_EQ(std::string_view{hay}.find(needle), find_substring(hay, needle)) << hay << " / " << needle;
+  }
+}
+
+TEST(search_test, find_substring_icase)
+{
+  EXPECT_EQ(0, find_substring_icase("ABC", "abc"));
+  EXPECT_EQ(1, find_substring_icase("x-Foo", "-foo"));
+  EXPECT_EQ(4, find_substring_icase("[@`]Z", "z"));
+  // only letters are folded.
+  EXPECT_EQ(std::string_view::npos, find_substring_icase("@[", "`{"));
+  EXPECT_EQ(std::string_view::npos, find_substring_icase(u8"Ä", u8"ä"));
+}
+
+TEST(search_test, find_substring_icase_random)
+{
+  std::mt19937 rng(54321);
+  for (int iter = 0; iter < 20000; ++iter) {
+    std::string hay(rng() % 300, ' '), needle(1 + rng() % 6, ' ');
+    for (auto& c : hay)
+      c = "aAbB@`"[rng() % 6];
+    for (auto& c : needle)
+      c = "ab@`"[rng() % 4];
+
+    std::string folded = hay;
+    for (auto& c : folded)
+      c = fold_ascii(c);
+    ASSERT_EQ(std::string_view{folded}.find(needle), find_substring_icase(hay, needle)) << hay << " / " << needle;
+  }
+}
@@ -0,0 +1,137 @@
+#include "stats.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+#include <ostream>
+#include <sys/resource.h>
+
+// allocations are counted only once a Stats is made, so that runs without --stats pay no more than a load.
+static std::atomic<bool> counting{false};
+static std::atomic<std::size_t> allocations{0};
+
+// every form of operator new and delete is replaced, as each form must be freed by its counterpart.
+// all of them allocate with malloc() or aligned_alloc(), and free with free().
+static void* allocate(std::size_t size, std::size_t alignment) noexcept
+{
+  if (counting.load(std::memory_order_relaxed)) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  size = size == 0 ? 1 : size;
+  if (alignment <= alignof(std::max_align_t)) {
+    return std::malloc(size);
+  }
+  // aligned_alloc() takes a multiple of the alignment.
+  return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+static void* allocate_or_throw(std::size_t size, std::size_t alignment)
+{
+  while (true) {
+    if (void* p = allocate(size, alignment)) {
+      return p;
+    }
+    auto handler = std::get_new_handler();
+    if (!handler) {
+      throw std::bad_alloc{};
+    }
+    handler();
+  }
+}
+
+static void* allocate_or_null(std::size_t size, std::size_t alignment) noexcept
+{
+  try {
+    return allocate_or_throw(size, alignment);
+  }
+  catch (...) {
+    return nullptr;
+  }
+}
+
+constexpr std::size_t default_alignment = alignof(std::max_align_t);
+
+void* operator new(std::size_t size) { return allocate_or_throw(size, default_alignment); }
+void* operator new[](std::size_t size) { return allocate_or_throw(size, default_alignment); }
+void* operator new(std::size_t size, std::nothrow_t const&) noexcept
+{
+  return allocate_or_null(size, default_alignment);
+}
+void* operator new[](std::size_t size, std::nothrow_t const&) noexcept
+{
+  return allocate_or_null(size, default_alignment);
+}
+void* operator new(std::size_t size, std::align_val_t al) { return allocate_or_throw(size, std::size_t(al)); }
+void* operator new[](std::size_t size, std::align_val_t al) { return allocate_or_throw(size, std::size_t(al)); }
+void* operator new(std::size_t size, std::align_val_t al, std::nothrow_t const&) noexcept
+{
+  return allocate_or_null(size, std::size_t(al));
+}
+void* operator new[](std::size_t size, std::align_val_t al, std::nothrow_t const&) noexcept
+{
+  return allocate_or_null(size, std::size_t(al));
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::nothrow_t const&) noexcept { std::free(p); }
+void operator delete[](void* p, std::nothrow_t const&) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t, std::nothrow_t const&) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t, std::nothrow_t const&) noexcept { std::free(p); }
+
+std::size_t num_allocations() { return allocations.load(std::memory_order_relaxed); }
+
+Stats::Stats() { counting.store(true, std::memory_order_relaxed); }
+
+void Stats::finish_ingest(std::size_t num_lines)
+{
+  ingest_lines = num_lines;
+  ingest_seconds = since_start.elapsed();
+}
+
+void Stats::report(std::ostream& os) const
+{
+  static char const* const names[] = {"key", "filter", "scoring", "ranking", "render"};
+
+  os << std::fixed << std::setprecision(3);
+  os << std::left << std::setw(10) << "stage" << std::right << std::setw(8) << "count" << std::setw(12) << "p50 ms"
+     << std::setw(12) << "p95 ms" << std::setw(12) << "max ms" << '\n';
+  for (int stage = 0; stage < num_stages; ++stage) {
+    auto sorted = samples[stage];
+    std::sort(sorted.begin(), sorted.end());
+    auto percentile = [&](double p) {
+      return sorted.empty() ? 0 : sorted[static_cast<std::size_t>(p * (sorted.size() - 1) + 0.5)] * 1e3;
+    };
+    os << std::left << std::setw(10) << names[stage] << std::right << std::setw(8) << sorted.size() << std::setw(12)
+       << percentile(0.5) << std::setw(12) << percentile(0.95) << std::setw(12) << percentile(1.0) << '\n';
+  }
+
+  if (ingest_seconds > 0) {
+    os << "ingest: " << ingest_lines << " lines in " << ingest_seconds << " s (" << std::setprecision(0)
+       << ingest_lines / ingest_seconds << " lines/s)\n";
+  }
+  else {
+    os << "ingest: not finished\n";
+  }
+
+  rusage usage;
+  ::getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  // bytes on macOS.
+  long max_rss = usage.ru_maxrss / 1024;
+#else
+  // kilobytes on Linux.
+  long max_rss = usage.ru_maxrss;
+#endif
+  os << "peak RSS: " << max_rss << " KiB\n";
+  os << "allocations: " << num_allocations() << '\n';
+}
@@ -0,0 +1,58 @@
+#ifndef __HEADER_STATS__
+#define __HEADER_STATS__
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+#include <vector>
+
+// measures the time elapsed since it is created or restarted.
+class Stopwatch {
+  std::chrono::steady_clock::time_point start;
+
+public:
+  Stopwatch() : start{std::chrono::steady_clock::now()} {}
+  void restart() { start = std::chrono::steady_clock::now(); }
+  // in seconds.
+  double elapsed() const { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); }
+};
+
+// latencies recorded by --stats, which are reported on exit.
+// all of them are recorded on the thread running the event loop. the worker measures its scoring time by itself
+// and passes it along with its results.
+class Stats {
+public:
+  enum Stage {
+    Key,     // handling a key event.
+    Filter,  // from requesting a query until all its results have arrived.
+    Scoring, // scoring lines for a query, summed over its blocks.
+    Ranking, // sorting matched lines when the view reaches the unsorted part.
+    Render,  // drawing a frame.
+    num_stages,
+  };
+
+private:
+  std::array<std::vector<double>, num_stages> samples;
+  Stopwatch since_start;
+  std::size_t ingest_lines = 0;
+  double ingest_seconds = 0;
+
+public:
+  // starts counting allocations for num_allocations().
+  Stats();
+
+  void record(Stage stage, double seconds) { samples[stage].push_back(seconds); }
+  // the last latency recorded for `stage`, or 0.
+  double last(Stage stage) const { return samples[stage].empty() ? 0 : samples[stage].back(); }
+  // called when all input has been read.
+  void finish_ingest(std::size_t num_lines);
+
+  // writes p50/p95/max of each stage, the ingest rate, the peak RSS and the number of allocations.
+  void report(std::ostream& os) const;
+};
+
+// the number of calls to operator new since the first Stats was made.
+std::size_t num_allocations();
+
+#endif
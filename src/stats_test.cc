@@ -0,0 +1,37 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include "stats.hh"
+
+TEST(stats_test, report)
+{
+  Stats stats;
+  for (int i = 1; i <= 100; ++i) {
+    stats.record(Stats::Render, i * 1e-3);
+  }
+  stats.record(Stats::Key, 2e-3);
+  EXPECT_DOUBLE_EQ(2e-3, stats.last(Stats::Key));
+  EXPECT_DOUBLE_EQ(0, stats.last(Stats::Ranking));
+
+  std::ostringstream os;
+  stats.report(os);
+  auto report = os.str();
+  EXPECT_NE(std::string::npos, report.find("render         100      51.000      95.000     100.000\n")) << report;
+  EXPECT_NE(std::string::npos, report.find("key              1       2.000       2.000       2.000\n")) << report;
+  EXPECT_NE(std::string::npos, report.find("ingest: not finished\n")) << report;
+
+  stats.finish_ingest(1000);
+  os.str("");
+  stats.report(os);
+  EXPECT_NE(std::string::npos, os.str().find("ingest: 1000 lines in ")) << os.str();
+}
+
+TEST(stats_test, num_allocations)
+{
+  Stats stats;
+  auto before = num_allocations();
+  auto p = std::make_unique<int>(42);
+  EXPECT_EQ(before + 1, num_allocations());
+}
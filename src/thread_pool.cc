@@ -0,0 +1,85 @@
+#include "thread_pool.hh"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(std::size_t num_threads)
+{
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (std::size_t i = 1; i < num_threads; ++i) {
+    workers.emplace_back([this] { worker_main(); });
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock{m};
+    stopped = true;
+  }
+  start_cv.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::run(std::size_t n, std::function<void(std::size_t)> const& task)
+{
+  if (workers.empty() || n <= 1) {
+    for (std::size_t i = 0; i < n; ++i) {
+      task(i);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock{m};
+    job = &task;
+    num_tasks = n;
+    next_task = 0;
+    running = workers.size();
+    ++generation;
+  }
+  start_cv.notify_all();
+
+  // the caller also takes part in the job.
+  drain(task, n);
+
+  std::unique_lock<std::mutex> lock{m};
+  done_cv.wait(lock, [this] { return running == 0; });
+  job = nullptr;
+}
+
+void ThreadPool::worker_main()
+{
+  std::size_t seen = 0;
+  while (true) {
+    std::function<void(std::size_t)> const* task;
+    std::size_t n;
+    {
+      std::unique_lock<std::mutex> lock{m};
+      start_cv.wait(lock, [&] { return stopped || generation != seen; });
+      if (stopped)
+        return;
+      seen = generation;
+      task = job;
+      n = num_tasks;
+    }
+
+    drain(*task, n);
+
+    {
+      std::lock_guard<std::mutex> lock{m};
+      --running;
+    }
+    done_cv.notify_one();
+  }
+}
+
+void ThreadPool::drain(std::function<void(std::size_t)> const& task, std::size_t n)
+{
+  for (std::size_t i = next_task++; i < n; i = next_task++) {
+    task(i);
+  }
+}
@@ -0,0 +1,43 @@
+#ifndef __HEADER_THREAD_POOL__
+#define __HEADER_THREAD_POOL__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// a persistent set of worker threads which runs data-parallel jobs.
+class ThreadPool {
+  std::vector<std::thread> workers;
+  std::mutex m;
+  std::condition_variable start_cv, done_cv;
+
+  std::function<void(std::size_t)> const* job = nullptr;
+  std::size_t num_tasks = 0;
+  std::atomic<std::size_t> next_task{0};
+  std::size_t generation = 0;
+  std::size_t running = 0;
+  bool stopped = false;
+
+public:
+  // `num_threads == 0` means the number of hardware threads.
+  explicit ThreadPool(std::size_t num_threads = 0);
+  ThreadPool(ThreadPool const&) = delete;
+  ThreadPool& operator=(ThreadPool const&) = delete;
+  ~ThreadPool();
+
+  // the number of threads which execute tasks, including the caller of `run()`.
+  std::size_t size() const noexcept { return workers.size() + 1; }
+
+  // calls `task(i)` for each i in [0, n) in parallel, and blocks until all of them finish.
+  void run(std::size_t n, std::function<void(std::size_t)> const& task);
+
+private:
+  void worker_main();
+  void drain(std::function<void(std::size_t)> const& task, std::size_t n);
+};
+
+#endif
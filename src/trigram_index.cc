@@ -0,0 +1,372 @@
+#include "trigram_index.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include "ansi.hh"
+
+struct TrigramIndex::Header {
+  char magic[8];
+  // what the file looked like when it was indexed.
+  std::uint64_t file_size;
+  std::int64_t mtime_sec;
+  std::int64_t mtime_nsec;
+  std::uint64_t sample_hash;
+
+  std::uint64_t num_lines;
+  std::uint64_t num_escaped;
+  std::uint64_t num_terms;
+  std::uint64_t num_postings;
+};
+
+struct TrigramIndex::Term {
+  std::uint32_t trigram;
+  std::uint32_t count;
+  std::uint64_t start;
+};
+
+namespace {
+
+constexpr char index_magic[8] = {'c', 'o', 'c', 'o', 't', 'r', 'i', '1'};
+constexpr std::size_t num_trigrams = std::size_t{1} << 24;
+
+// the bytes at both ends of a file are hashed to tell it from another one of the same size and time.
+constexpr std::size_t sample_size = 65536;
+
+std::uint64_t hash_sample(std::string_view data)
+{
+  auto fnv1a = [](std::uint64_t h, std::string_view s) {
+    for (unsigned char c : s) {
+      h = (h ^ c) * 1099511628211ull;
+    }
+    return h;
+  };
+  std::uint64_t h = fnv1a(14695981039346656037ull, data.substr(0, sample_size));
+  if (data.size() > sample_size) {
+    h = fnv1a(h, data.substr(std::max(sample_size, data.size() - sample_size)));
+  }
+  return h;
+}
+
+std::size_t align8(std::size_t n) { return (n + 7) & ~std::size_t{7}; }
+
+// the positions of the sections in an index file.
+struct Layout {
+  std::size_t offsets, escaped, terms, postings, total;
+
+  explicit Layout(TrigramIndex::Header const& h)
+  {
+    offsets = align8(sizeof(TrigramIndex::Header));
+    escaped = offsets + (h.num_lines + 1) * sizeof(std::uint64_t);
+    terms = escaped + align8(h.num_escaped * sizeof(std::uint32_t));
+    postings = terms + h.num_terms * sizeof(TrigramIndex::Term);
+    total = postings + h.num_postings * sizeof(std::uint32_t);
+  }
+};
+
+// checks that the sections of an index of `size` bytes are where its header says and refer only to each other and
+// to a file of `file_size` bytes, so that a broken index is never read out of bounds.
+// postings are not checked here, which would read the whole index. lookup() drops lines out of range instead.
+bool is_consistent(TrigramIndex::Header const& h, char const* base, std::size_t size, std::size_t file_size)
+{
+  // bounded first, so that the layout does not overflow.
+  if (h.num_lines > std::numeric_limits<std::uint32_t>::max() || h.num_escaped > h.num_lines ||
+      h.num_terms > num_trigrams || h.num_postings > size / sizeof(std::uint32_t)) {
+    return false;
+  }
+  Layout layout{h};
+  if (layout.total != size) {
+    return false;
+  }
+
+  // every line ends with a newline, except maybe the last one, and lies within the file.
+  auto offsets = reinterpret_cast<std::uint64_t const*>(base + layout.offsets);
+  if (offsets[0] != 0 || offsets[h.num_lines] > file_size + 1) {
+    return false;
+  }
+  for (std::size_t i = 0; i < h.num_lines; ++i) {
+    if (offsets[i + 1] <= offsets[i]) {
+      return false;
+    }
+  }
+
+  auto escaped = reinterpret_cast<std::uint32_t const*>(base + layout.escaped);
+  for (std::size_t i = 0; i < h.num_escaped; ++i) {
+    if (escaped[i] >= h.num_lines || (i > 0 && escaped[i] <= escaped[i - 1])) {
+      return false;
+    }
+  }
+
+  auto terms = reinterpret_cast<TrigramIndex::Term const*>(base + layout.terms);
+  for (std::size_t i = 0; i < h.num_terms; ++i) {
+    auto const& term = terms[i];
+    if (term.trigram >= num_trigrams || (i > 0 && term.trigram <= terms[i - 1].trigram) ||
+        term.start > h.num_postings || term.count > h.num_postings - term.start) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// puts the distinct trigrams of `line` into `keys` in ascending order.
+void trigrams_of(std::string_view line, std::vector<std::uint32_t>& keys)
+{
+  keys.clear();
+  for (std::size_t i = 0; i + 3 <= line.size(); ++i) {
+    keys.push_back(trigram_key(line.data() + i));
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+}
+
+bool stat_file(std::string const& path, struct stat& st) { return ::stat(path.c_str(), &st) == 0; }
+
+std::int64_t mtime_sec(struct stat const& st)
+{
+#ifdef __APPLE__
+  return st.st_mtimespec.tv_sec;
+#else
+  return st.st_mtim.tv_sec;
+#endif
+}
+
+std::int64_t mtime_nsec(struct stat const& st)
+{
+#ifdef __APPLE__
+  return st.st_mtimespec.tv_nsec;
+#else
+  return st.st_mtim.tv_nsec;
+#endif
+}
+
+// calls `f(index, line)` for each line of `data`, as read_mapped_lines() splits them.
+template <typename F>
+void for_each_line(std::string_view data, F&& f)
+{
+  char const* p = data.data();
+  char const* end = p + data.size();
+  for (std::size_t i = 0; p < end; ++i) {
+    auto eol = static_cast<char const*>(std::memchr(p, '\n', end - p));
+    if (eol == nullptr) {
+      eol = end;
+    }
+    f(i, std::string_view(p, eol - p));
+    p = std::min(eol + 1, end);
+  }
+}
+
+} // namespace
+
+TrigramIndex::TrigramIndex(std::shared_ptr<MappedFile> file, std::shared_ptr<MappedFile> index)
+    : file{std::move(file)}, index{std::move(index)}
+{
+  char const* base = this->index->data();
+  header = reinterpret_cast<Header const*>(base);
+  Layout layout{*header};
+  offsets = reinterpret_cast<std::uint64_t const*>(base + layout.offsets);
+  escaped = reinterpret_cast<std::uint32_t const*>(base + layout.escaped);
+  terms = reinterpret_cast<Term const*>(base + layout.terms);
+  postings = reinterpret_cast<std::uint32_t const*>(base + layout.postings);
+}
+
+std::string TrigramIndex::sidecar_path(std::string const& path) { return path + ".coco-index"; }
+
+std::size_t TrigramIndex::num_lines() const noexcept { return header->num_lines; }
+
+std::uint32_t const* TrigramIndex::escaped_end() const noexcept { return escaped + header->num_escaped; }
+
+std::shared_ptr<TrigramIndex const> TrigramIndex::open(std::string const& path, std::string const& index_path)
+{
+  auto index = MappedFile::open(index_path);
+  if (!index || index->size() < sizeof(Header)) {
+    return nullptr;
+  }
+  Header const& h = *reinterpret_cast<Header const*>(index->data());
+  if (std::memcmp(h.magic, index_magic, sizeof(index_magic)) != 0) {
+    return nullptr;
+  }
+
+  struct stat st;
+  if (!stat_file(path, st) || h.file_size != static_cast<std::uint64_t>(st.st_size) || h.mtime_sec != mtime_sec(st) ||
+      h.mtime_nsec != mtime_nsec(st)) {
+    return nullptr;
+  }
+  auto file = MappedFile::open(path);
+  if (!file || file->size() != h.file_size || hash_sample(file->view()) != h.sample_hash ||
+      !is_consistent(h, index->data(), index->size(), file->size())) {
+    return nullptr;
+  }
+  return std::shared_ptr<TrigramIndex const>(new TrigramIndex(std::move(file), std::move(index)));
+}
+
+void TrigramIndex::build(std::string const& path, std::string const& index_path)
+{
+  struct stat st;
+  auto file = MappedFile::open(path);
+  if (!file || !stat_file(path, st)) {
+    throw std::runtime_error(path + ": not a regular file");
+  }
+
+  Header h{};
+  std::memcpy(h.magic, index_magic, sizeof(index_magic));
+  h.file_size = file->size();
+  h.mtime_sec = mtime_sec(st);
+  h.mtime_nsec = mtime_nsec(st);
+  h.sample_hash = hash_sample(file->view());
+
+  // the first pass counts the lines containing each trigram.
+  std::vector<std::uint64_t> offsets{0};
+  std::vector<std::uint32_t> escaped;
+  std::vector<std::uint32_t> counts(num_trigrams);
+  std::vector<std::uint32_t> keys;
+  std::string stripped;
+  for_each_line(file->view(), [&](std::size_t i, std::string_view line) {
+    offsets.push_back(line.data() + line.size() + 1 - file->data());
+    if (strip_ansi(line, stripped)) {
+      escaped.push_back(static_cast<std::uint32_t>(i));
+      line = stripped;
+    }
+    trigrams_of(line, keys);
+    for (auto key : keys) {
+      ++counts[key];
+    }
+  });
+  h.num_lines = offsets.size() - 1;
+  if (h.num_lines > std::numeric_limits<std::uint32_t>::max()) {
+    throw std::runtime_error(path + ": too many lines to index");
+  }
+  h.num_escaped = escaped.size();
+
+  // `counts` is turned into the term of each trigram, and `next` tells where its next posting goes.
+  std::vector<Term> terms;
+  std::vector<std::uint64_t> next;
+  for (std::size_t key = 0; key < num_trigrams; ++key) {
+    if (counts[key] > 0) {
+      terms.push_back(Term{static_cast<std::uint32_t>(key), counts[key], h.num_postings});
+      next.push_back(h.num_postings);
+      h.num_postings += counts[key];
+      counts[key] = static_cast<std::uint32_t>(terms.size() - 1);
+    }
+  }
+  h.num_terms = terms.size();
+  Layout layout{h};
+
+  // written to a temporary file first, so that a reader never maps a half-written index.
+  // it is unique to this build, as other processes may be indexing the same file.
+  std::string tmp_path = index_path + ".XXXXXX";
+  int fd = ::mkstemp(&tmp_path[0]);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), tmp_path);
+  }
+  void* addr = MAP_FAILED;
+  if (::fchmod(fd, 0644) == 0 && ::ftruncate(fd, layout.total) == 0) {
+    addr = ::mmap(nullptr, layout.total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  int err = errno;
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    ::unlink(tmp_path.c_str());
+    throw std::system_error(err, std::generic_category(), tmp_path);
+  }
+
+  char* base = static_cast<char*>(addr);
+  std::memcpy(base + layout.offsets, offsets.data(), offsets.size() * sizeof(std::uint64_t));
+  std::memcpy(base + layout.escaped, escaped.data(), escaped.size() * sizeof(std::uint32_t));
+  std::memcpy(base + layout.terms, terms.data(), terms.size() * sizeof(Term));
+
+  // the second pass fills the postings, which come in ascending order of lines.
+  auto postings = reinterpret_cast<std::uint32_t*>(base + layout.postings);
+  for_each_line(file->view(), [&](std::size_t i, std::string_view line) {
+    if (strip_ansi(line, stripped)) {
+      line = stripped;
+    }
+    trigrams_of(line, keys);
+    for (auto key : keys) {
+      postings[next[counts[key]]++] = static_cast<std::uint32_t>(i);
+    }
+  });
+
+  // the header goes last, as it marks the index complete.
+  std::memcpy(base, &h, sizeof(h));
+  ::munmap(addr, layout.total);
+  if (std::rename(tmp_path.c_str(), index_path.c_str()) != 0) {
+    err = errno;
+    ::unlink(tmp_path.c_str());
+    throw std::system_error(err, std::generic_category(), index_path);
+  }
+}
+
+std::shared_ptr<TrigramIndex const> TrigramIndex::load(std::string const& path)
+{
+  auto index_path = sidecar_path(path);
+  if (auto index = open(path, index_path)) {
+    return index;
+  }
+  build(path, index_path);
+  return open(path, index_path);
+}
+
+bool TrigramIndex::lookup(std::vector<std::string> const& substrings, std::size_t first, std::size_t last,
+                          std::vector<std::uint32_t>& out) const
+{
+  std::vector<std::uint32_t> keys;
+  for (auto& s : substrings) {
+    for (std::size_t i = 0; i + 3 <= s.size(); ++i) {
+      keys.push_back(trigram_key(s.data() + i));
+    }
+  }
+  if (keys.empty()) {
+    return false;
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  out.clear();
+  last = std::min(last, num_lines());
+  if (first >= last) {
+    return true;
+  }
+
+  // the range of postings of each trigram within [first, last).
+  std::vector<std::pair<std::uint32_t const*, std::uint32_t const*>> lists;
+  Term const* terms_end = terms + header->num_terms;
+  for (auto key : keys) {
+    auto term = std::lower_bound(terms, terms_end, key, [](Term const& t, std::uint32_t k) { return t.trigram < k; });
+    if (term == terms_end || term->trigram != key) {
+      return true;
+    }
+    auto begin = postings + term->start;
+    auto end = begin + term->count;
+    begin = std::lower_bound(begin, end, first);
+    end = std::lower_bound(begin, end, last);
+    lists.emplace_back(begin, end);
+  }
+
+  // the shortest list is walked, and each of its lines is looked up in the others.
+  std::sort(lists.begin(), lists.end(), [](auto& a, auto& b) { return a.second - a.first < b.second - b.first; });
+  for (auto p = lists[0].first; p != lists[0].second; ++p) {
+    bool found = true;
+    for (std::size_t k = 1; k < lists.size() && found; ++k) {
+      auto& list = lists[k];
+      list.first = std::lower_bound(list.first, list.second, *p);
+      if (list.first == list.second) {
+        return true;
+      }
+      found = *list.first == *p;
+    }
+    // a broken index may have lines out of order or beyond the file.
+    if (found && first <= *p && *p < last) {
+      out.push_back(*p);
+    }
+  }
+  return true;
+}
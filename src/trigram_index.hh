@@ -0,0 +1,71 @@
+#ifndef __HEADER_TRIGRAM_INDEX__
+#define __HEADER_TRIGRAM_INDEX__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "line_index.hh"
+#include "mapped_file.hh"
+
+// a sidecar file which maps each trigram of a file to the lines containing it, so that queries look at the
+// lines which may match rather than scanning the whole file on every run.
+//
+// the index is mapped as it is, and laid out in native byte order with every section aligned to 8 bytes:
+//   Header
+//   uint64 offsets[num_lines + 1]  the start of each line, and the end of the last one plus one.
+//   uint32 escaped[num_escaped]    lines containing escape sequences, which are stripped when they are read.
+//   Term terms[num_terms]          trigrams in ascending order, with the range of their postings.
+//   uint32 postings[num_postings]  line numbers, ascending within each trigram.
+// trigrams are taken from lines with escape sequences stripped and ASCII letters lower-cased,
+// so that an index serves both case-sensitive and case-insensitive queries.
+class TrigramIndex : public LineIndex {
+public:
+  struct Header;
+  struct Term;
+
+private:
+  std::shared_ptr<MappedFile> file;
+  std::shared_ptr<MappedFile> index;
+  Header const* header;
+  std::uint64_t const* offsets;
+  std::uint32_t const* escaped;
+  Term const* terms;
+  std::uint32_t const* postings;
+
+  TrigramIndex(std::shared_ptr<MappedFile> file, std::shared_ptr<MappedFile> index);
+
+public:
+  // where the index of `path` is kept.
+  static std::string sidecar_path(std::string const& path);
+
+  // maps the index of `path` stored at `index_path`. returns nullptr if it is missing, broken,
+  // or out of date, i.e. the size, modification time or sampled contents of the file have changed.
+  static std::shared_ptr<TrigramIndex const> open(std::string const& path, std::string const& index_path);
+
+  // indexes `path` into `index_path`, replacing it atomically. throws std::runtime_error on failure.
+  static void build(std::string const& path, std::string const& index_path);
+
+  // opens the sidecar index of `path`, building it first if it is not up to date.
+  static std::shared_ptr<TrigramIndex const> load(std::string const& path);
+
+  std::size_t num_lines() const noexcept override;
+  // the line `i` as it is in the file, without its newline.
+  std::string_view line(std::size_t i) const noexcept
+  {
+    return {file->data() + offsets[i], static_cast<std::size_t>(offsets[i + 1] - offsets[i] - 1)};
+  }
+  // the lines containing escape sequences, in ascending order.
+  std::uint32_t const* escaped_begin() const noexcept { return escaped; }
+  std::uint32_t const* escaped_end() const noexcept;
+  // the mapped file, which lines returned by line() refer to.
+  std::shared_ptr<MappedFile> const& mapped_file() const noexcept { return file; }
+
+  // no substring shorter than three bytes narrows the lines down.
+  bool lookup(std::vector<std::string> const& substrings, std::size_t first, std::size_t last,
+              std::vector<std::uint32_t>& out) const override;
+};
+
+#endif
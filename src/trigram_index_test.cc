@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include "search.hh"
+#include "trigram_index.hh"
+
+// makes an empty file of a unique name in the temporary directory.
+static std::string make_temp_file(std::string const& name)
+{
+  auto path = (std::filesystem::temp_directory_path() / (name + ".XXXXXX")).string();
+  int fd = ::mkstemp(&path[0]);
+  if (fd >= 0) {
+    ::close(fd);
+  }
+  return path;
+}
+
+static void write_file(std::string const& path, std::string const& content)
+{
+  std::ofstream{path, std::ios::binary} << content;
+}
+
+TEST(trigram_index_test, lines)
+{
+  auto path = make_temp_file("trigram_lines");
+  write_file(path, "foo\n\n\x1b[1mbar\x1b[0m\nbaz");
+  auto index_path = TrigramIndex::sidecar_path(path);
+  std::remove(index_path.c_str());
+  EXPECT_EQ(nullptr, TrigramIndex::open(path, index_path));
+
+  auto index = TrigramIndex::load(path);
+  ASSERT_NE(nullptr, index);
+  ASSERT_EQ(4, index->num_lines());
+  EXPECT_EQ("foo", index->line(0));
+  EXPECT_EQ("", index->line(1));
+  EXPECT_EQ("\x1b[1mbar\x1b[0m", index->line(2));
+  EXPECT_EQ("baz", index->line(3));
+  ASSERT_EQ(1, index->escaped_end() - index->escaped_begin());
+  EXPECT_EQ(2, *index->escaped_begin());
+
+  // trigrams are taken from lines with escape sequences stripped.
+  std::vector<std::uint32_t> found;
+  ASSERT_TRUE(index->lookup({"BAR"}, 0, 4, found));
+  EXPECT_EQ(std::vector<std::uint32_t>{2}, found);
+  EXPECT_FALSE(index->lookup({"ba", ""}, 0, 4, found));
+
+  // opened again without building.
+  EXPECT_NE(nullptr, TrigramIndex::open(path, index_path));
+}
+
+TEST(trigram_index_test, out_of_date)
+{
+  auto path = make_temp_file("trigram_stale");
+  write_file(path, "foo\nbar\n");
+  auto index_path = TrigramIndex::sidecar_path(path);
+  TrigramIndex::build(path, index_path);
+  ASSERT_NE(nullptr, TrigramIndex::open(path, index_path));
+
+  // the same size and modification time, but different contents.
+  struct stat st;
+  ASSERT_EQ(0, ::stat(path.c_str(), &st));
+  write_file(path, "foo\nbaz\n");
+  struct timespec times[2] = {st.st_atim, st.st_mtim};
+  ASSERT_EQ(0, ::utimensat(AT_FDCWD, path.c_str(), times, 0));
+  EXPECT_EQ(nullptr, TrigramIndex::open(path, index_path));
+
+  write_file(path, "foo\nbar\nbaz\n");
+  EXPECT_EQ(nullptr, TrigramIndex::open(path, index_path));
+  auto index = TrigramIndex::load(path);
+  ASSERT_NE(nullptr, index);
+  EXPECT_EQ(3, index->num_lines());
+}
+
+// overwrites 8 bytes at `pos` of `path`.
+static void overwrite(std::string const& path, std::streamoff pos, std::uint64_t value)
+{
+  std::fstream f{path, std::ios::in | std::ios::out | std::ios::binary};
+  f.seekp(pos);
+  f.write(reinterpret_cast<char const*>(&value), sizeof(value));
+}
+
+TEST(trigram_index_test, broken)
+{
+  auto path = make_temp_file("trigram_broken");
+  write_file(path, "foo\nbar\n");
+  auto index_path = TrigramIndex::sidecar_path(path);
+
+  // the header takes 72 bytes, followed by the offsets of 2 lines, and the terms as no line has escapes.
+  std::streamoff const offsets = 72, terms = offsets + 3 * 8;
+  for (auto corrupt : {std::make_pair(offsets + 8, std::uint64_t{1} << 40),   // a line beyond the file.
+                       std::make_pair(offsets + 8, std::uint64_t{0}),         // an empty range of a line.
+                       std::make_pair(terms + 8, std::uint64_t{1} << 40)}) {  // postings beyond the index.
+    TrigramIndex::build(path, index_path);
+    ASSERT_NE(nullptr, TrigramIndex::open(path, index_path));
+    overwrite(index_path, corrupt.first, corrupt.second);
+    EXPECT_EQ(nullptr, TrigramIndex::open(path, index_path));
+
+    // rebuilt when loaded.
+    auto index = TrigramIndex::load(path);
+    ASSERT_NE(nullptr, index);
+    EXPECT_EQ("bar", index->line(1));
+  }
+}
+
+// the lines found are the ones containing every trigram of the substrings.
+TEST(trigram_index_test, lookup)
+{
+  std::mt19937 rng(1);
+  auto random_string = [&](std::size_t len) {
+    static char const alphabet[] = "abcABC-";
+    std::string s;
+    for (std::size_t i = 0; i < len; ++i) {
+      s += alphabet[rng() % 7];
+    }
+    return s;
+  };
+
+  std::vector<std::string> lines;
+  std::string content;
+  for (int i = 0; i < 5000; ++i) {
+    lines.push_back(random_string(rng() % 12));
+    content += lines.back() + "\n";
+  }
+  auto path = make_temp_file("trigram_lookup");
+  write_file(path, content);
+  auto index = TrigramIndex::load(path);
+  ASSERT_NE(nullptr, index);
+  ASSERT_EQ(lines.size(), index->num_lines());
+
+  auto folded = [](std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(), fold_ascii);
+    return s;
+  };
+  for (int n = 0; n < 200; ++n) {
+    std::vector<std::string> substrings{random_string(3 + rng() % 3)};
+    if (n % 2) {
+      substrings.push_back(random_string(3));
+    }
+    std::size_t first = rng() % lines.size();
+    std::size_t last = first + rng() % (lines.size() - first + 1);
+
+    std::vector<std::uint32_t> expected;
+    for (std::size_t i = first; i < last; ++i) {
+      bool all = true;
+      for (auto& s : substrings) {
+        for (std::size_t k = 0; k + 3 <= s.size(); ++k) {
+          all = all && folded(lines[i]).find(folded(s.substr(k, 3))) != std::string::npos;
+        }
+      }
+      if (all) {
+        expected.push_back(i);
+      }
+    }
+
+    std::vector<std::uint32_t> found;
+    ASSERT_TRUE(index->lookup(substrings, first, last, found));
+    EXPECT_EQ(expected, found) << substrings[0];
+  }
+}
@@ -1,7 +1,14 @@
 #include "utf8.hh"
+#include "search.hh"
+#include "unicode_width.hh"
+#include <algorithm>
+#include <cwctype>
 #include <stdexcept>
-#include <locale>
-#include <codecvt>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define COCO_UTF8_X86 1
+#endif
 
 bool is_utf8_first(uint8_t ch)
 {
@@ -38,28 +45,171 @@ void pop_back_utf8(std::string& str)
   }
 }
 
+// decodes the character at `s[i]` and moves `i` past it.
+// returns false and leaves `i` as it is if `s[i]` does not start a valid sequence.
+static bool decode_utf8(std::string_view s, std::size_t& i, char32_t& ch)
+{
+  std::uint8_t c = s[i];
+  std::size_t len = c < 0x80 ? 1 : (c & 0xE0) == 0xC0 ? 2 : (c & 0xF0) == 0xE0 ? 3 : (c & 0xF8) == 0xF0 ? 4 : 0;
+  if (len == 0 || i + len > s.size()) {
+    return false;
+  }
+
+  ch = len == 1 ? c : c & (0x7F >> len);
+  for (std::size_t k = 1; k < len; ++k) {
+    if (!is_utf8_cont(s[i + k])) {
+      return false;
+    }
+    ch = (ch << 6) | (s[i + k] & 0x3F);
+  }
+  i += len;
+  return true;
+}
+
 std::size_t get_mb_width(std::string const& s)
 {
   if (get_utf8_char_length(s[0]) < s.size()) {
     throw std::runtime_error(std::string(__FUNCTION__) + ": a UTF-8 character is only allowed.");
   }
 
-  // http://php.net/manual/ja/function.mb-strwidth.php
-  std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t> converter;
-  std::u32string u32str = converter.from_bytes(s);
-  if (u32str[0] < 0x0020) {
-    return 0;
-  }
-  else if (u32str[0] >= 0x0020 && u32str[0] < 0x2000) {
+  std::size_t i = 0;
+  char32_t ch;
+  if (!decode_utf8(s, i, ch)) {
     return 1;
   }
-  else if (u32str[0] >= 0x2000 && u32str[0] < 0xFF61) {
-    return 2;
+  return ch < 0x20 ? 0 : unicode_width(ch);
+}
+
+static void encode_utf8(char32_t ch, std::string& out)
+{
+  if (ch < 0x80) {
+    out += static_cast<char>(ch);
   }
-  else if (u32str[0] >= 0xFF61 && u32str[0] < 0xFF9F) {
-    return 1;
+  else if (ch < 0x800) {
+    out += static_cast<char>(0xC0 | (ch >> 6));
+    out += static_cast<char>(0x80 | (ch & 0x3F));
+  }
+  else if (ch < 0x10000) {
+    out += static_cast<char>(0xE0 | (ch >> 12));
+    out += static_cast<char>(0x80 | ((ch >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (ch & 0x3F));
   }
   else {
+    out += static_cast<char>(0xF0 | (ch >> 18));
+    out += static_cast<char>(0x80 | ((ch >> 12) & 0x3F));
+    out += static_cast<char>(0x80 | ((ch >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (ch & 0x3F));
+  }
+}
+
+void fold_case_utf8(std::string_view s, std::string& out)
+{
+  out.reserve(out.size() + s.size());
+  for (std::size_t i = 0; i < s.size();) {
+    char32_t ch;
+    if (static_cast<std::uint8_t>(s[i]) < 0x80) {
+      out += fold_ascii(s[i++]);
+    }
+    else if (decode_utf8(s, i, ch)) {
+      encode_utf8(static_cast<char32_t>(std::towlower(static_cast<std::wint_t>(ch))), out);
+    }
+    else {
+      out += s[i++];
+    }
+  }
+}
+
+bool has_upper_utf8(std::string_view s)
+{
+  for (std::size_t i = 0; i < s.size();) {
+    char32_t ch;
+    if (static_cast<std::uint8_t>(s[i]) < 0x80) {
+      if ('A' <= s[i] && s[i] <= 'Z') {
+        return true;
+      }
+      ++i;
+    }
+    else if (decode_utf8(s, i, ch)) {
+      if (std::iswupper(static_cast<std::wint_t>(ch))) {
+        return true;
+      }
+    }
+    else {
+      ++i;
+    }
+  }
+  return false;
+}
+
+std::size_t get_char_width(char32_t ch)
+{
+  if (ch < 0x20 || ch == 0x7F) {
     return 2;
   }
-}
\ No newline at end of file
+  return unicode_width(ch);
+}
+
+// returns the length of the run of printable ASCII characters at the head of `s`, looking at most `n` bytes.
+static std::size_t printable_ascii_run(char const* s, std::size_t n)
+{
+  std::size_t i = 0;
+#ifdef COCO_UTF8_X86
+  __m128i const space = _mm_set1_epi8(0x1F), del = _mm_set1_epi8(0x7F);
+  for (; i + 16 <= n; i += 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s + i));
+    // bytes from 0x80 are negative as signed, and fail the first comparison.
+    __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(block, space), _mm_cmplt_epi8(block, del));
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(printable));
+    if (mask != 0xFFFF) {
+      return i + __builtin_ctz(~mask);
+    }
+  }
+#endif
+  while (i < n && 0x20 <= s[i] && s[i] < 0x7F) {
+    ++i;
+  }
+  return i;
+}
+
+std::string_view clip_to_width(std::string_view s, std::size_t width, std::size_t& used)
+{
+  used = 0;
+  std::size_t i = 0;
+  while (i < s.size()) {
+    // printable ASCII characters take a column each.
+    std::size_t run = printable_ascii_run(s.data() + i, std::min(s.size() - i, width - used));
+    i += run;
+    used += run;
+    if (i == s.size()) {
+      break;
+    }
+
+    std::size_t next = i;
+    std::size_t w;
+    char32_t ch;
+    if (0x20 <= s[i] && s[i] < 0x7F) {
+      next = i + 1;
+      w = 1;
+    }
+    else if (decode_utf8(s, next, ch)) {
+      w = get_char_width(ch);
+    }
+    else {
+      next = i + 1;
+      w = 1;
+    }
+
+    if (used + w > width) {
+      break;
+    }
+    used += w;
+    i = next;
+  }
+  return s.substr(0, i);
+}
+
+std::string_view clip_to_width(std::string_view s, std::size_t width)
+{
+  std::size_t used;
+  return clip_to_width(s, width, used);
+}
@@ -3,6 +3,7 @@
 
 #include <cstdio>
 #include <string>
+#include <string_view>
 
 bool is_utf8_first(std::uint8_t ch);
 bool is_utf8_cont(std::uint8_t ch);
@@ -12,4 +13,20 @@ std::size_t get_mb_width(std::string const& s);
 
 void pop_back_utf8(std::string& str);
 
+// appends `s` to `out` with every character lower-cased by towlower() of the current C locale.
+// ASCII letters are folded through a table, and invalid bytes are copied as they are.
+void fold_case_utf8(std::string_view s, std::string& out);
+
+// returns true if `s` has an uppercase character, in the sense of iswupper().
+bool has_upper_utf8(std::string_view s);
+
+// returns the number of columns which a character takes on the terminal.
+// control characters are counted as two columns, since ncurses draws them as `^X`.
+std::size_t get_char_width(char32_t ch);
+
+// returns the longest prefix of `s` which fits in `width` columns, without splitting a character.
+// the number of columns it takes is stored to `used`. invalid bytes are counted as a column each.
+std::string_view clip_to_width(std::string_view s, std::size_t width, std::size_t& used);
+std::string_view clip_to_width(std::string_view s, std::size_t width);
+
 #endif
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 
+#include <clocale>
 #include "utf8.hh"
 
 TEST(utf8_test, is_utf8_first)
@@ -53,4 +54,86 @@ TEST(utf8_test, get_mb_width)
   EXPECT_EQ(2, get_mb_width(u8"あ"));
   EXPECT_EQ(2, get_mb_width(u8"🍣"));
   EXPECT_EQ(0, get_mb_width(u8"\n"));
+  EXPECT_EQ(1, get_mb_width(u8"ｱ"));
+  EXPECT_EQ(1, get_mb_width(u8"‐"));
+  EXPECT_EQ(0, get_mb_width(u8"\u0301"));
+}
+
+TEST(utf8_test, get_char_width)
+{
+  EXPECT_EQ(2, get_char_width(U'\t'));
+  EXPECT_EQ(2, get_char_width(0x7F));
+  EXPECT_EQ(1, get_char_width(U'é'));
+  EXPECT_EQ(1, get_char_width(U'→'));
+  EXPECT_EQ(2, get_char_width(U'가'));
+  EXPECT_EQ(2, get_char_width(U'　'));
+  EXPECT_EQ(2, get_char_width(U'\U00020000'));
+  EXPECT_EQ(1, get_char_width(U'\U0001F100'));
+  EXPECT_EQ(2, get_char_width(U'\U0001F680'));
+  // combining marks, joiners and variation selectors.
+  EXPECT_EQ(0, get_char_width(U'\u0301'));
+  EXPECT_EQ(0, get_char_width(U'\u200D'));
+  EXPECT_EQ(0, get_char_width(U'\uFE0F'));
+  EXPECT_EQ(0, get_char_width(U'\U000E0100'));
+}
+
+TEST(utf8_test, clip_to_width)
+{
+  std::size_t used;
+  EXPECT_EQ("abc", clip_to_width("abcdef", 3, used));
+  EXPECT_EQ(3, used);
+  EXPECT_EQ("ab", clip_to_width("ab", 3, used));
+  EXPECT_EQ(2, used);
+
+  // a wide character which does not fit is left out as a whole.
+  EXPECT_EQ(u8"aほ", clip_to_width(u8"aほげ", 4, used));
+  EXPECT_EQ(3, used);
+  EXPECT_EQ(u8"🍣", clip_to_width(u8"🍣🍣", 3));
+
+  EXPECT_EQ("a", clip_to_width("a\x01", 2, used));
+  EXPECT_EQ("a\xff", clip_to_width("a\xff\xe3", 2, used));
+  EXPECT_EQ("", clip_to_width(u8"ほ", 1));
+
+  // combining marks stay with the character before them.
+  EXPECT_EQ(u8"e\u0301e\u0301", clip_to_width(u8"e\u0301e\u0301e", 2, used));
+  EXPECT_EQ(2, used);
+
+  std::string ascii(40, 'x');
+  EXPECT_EQ(ascii.substr(0, 33), clip_to_width(ascii, 33, used));
+  EXPECT_EQ(33, used);
+  EXPECT_EQ(ascii.substr(0, 20) + u8"ほ", clip_to_width(ascii.substr(0, 20) + u8"ほ" + ascii, 22, used));
+  EXPECT_EQ(22, used);
+  EXPECT_EQ(ascii.substr(0, 17), clip_to_width(ascii.substr(0, 17) + "\x01" + ascii, 18, used));
+  EXPECT_EQ(17, used);
+}
+
+TEST(utf8_test, fold_case_utf8)
+{
+  std::string out = "x";
+  fold_case_utf8("Foo BAR", out);
+  EXPECT_EQ("xfoo bar", out);
+
+  // invalid bytes are kept.
+  out.clear();
+  fold_case_utf8("A\xff\xe3\x81", out);
+  EXPECT_EQ("a\xff\xe3\x81", out);
+
+  if (std::setlocale(LC_CTYPE, "C.UTF-8") != nullptr) {
+    out.clear();
+    fold_case_utf8(u8"ÄÖ ほげ Ω", out);
+    EXPECT_EQ(u8"äö ほげ ω", out);
+    std::setlocale(LC_CTYPE, "C");
+  }
+}
+
+TEST(utf8_test, has_upper_utf8)
+{
+  EXPECT_TRUE(has_upper_utf8("fooBar"));
+  EXPECT_FALSE(has_upper_utf8(u8"foo ほげ"));
+
+  if (std::setlocale(LC_CTYPE, "C.UTF-8") != nullptr) {
+    EXPECT_TRUE(has_upper_utf8(u8"fooÄ"));
+    EXPECT_FALSE(has_upper_utf8(u8"fooä"));
+    std::setlocale(LC_CTYPE, "C");
+  }
 }